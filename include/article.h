@@ -12,13 +12,29 @@ Article_t* duplicate_article(const Article_t* original);
 Article_t* article_from_file(FILE* in);
 void delete_article(Article_t* a);
 
+// Blocks hold count contiguous articles and are only ever freed as a whole
+Article_t* make_article_block(unsigned long count);
+void delete_article_block(Article_t* block);
+
 // Queries
 const char* key_of(const Article_t* article);
+unsigned long key_length_of(const Article_t* article);
+unsigned long stored_key_length(unsigned long len); // Keys longer than the field are stored, and compared, truncated
 bool article_has_key(const Article_t* article, const char* key);
+bool article_has_key_n(const Article_t* article, const char* key, unsigned long len); // key need not be terminated
 bool articles_are_equal(const Article_t* a, const Article_t* b);
+unsigned long article_footprint(void);
+Article_t* article_in_block(Article_t* block, unsigned long i);
+bool article_is_in_block(const Article_t* block, unsigned long count, const Article_t* article);
+
+// Records are fixed-size native-endian images of an article, article_footprint() bytes long,
+// meant for memory-mapped storage. Views stay valid as long as the record memory does
+const Article_t* article_view_of_record(const void* record);
 
 // Commands
 void display_article(const Article_t* article, FILE* out);
 void dump_article(const Article_t* article, FILE* out);
+void copy_article(const Article_t* original, Article_t* target);
+void article_to_record(const Article_t* article, void* record);
 
 #endif //ARTICLE_H
@@ -0,0 +1,31 @@
+#ifndef CUCKOO_TABLE_H
+#define CUCKOO_TABLE_H
+
+#include <stdbool.h>
+
+#include "article.h"
+
+/*
+ * Bucketized cuckoo hash table of articles
+ * Every key has two candidate buckets of 4 slots, each bucket one cache line,
+ * so a lookup inspects at most two lines (plus the article whose tag matched)
+ * Inserts displace at most a bounded number of residents, then grow the table
+ */
+
+typedef struct CuckooTable_s CuckooTable_t;
+
+// Constructors/Destructors
+CuckooTable_t* ct_new(void);
+void ct_delete(CuckooTable_t* ct);
+
+// Queries
+bool ct_contains(const CuckooTable_t* ct, const char* key);
+unsigned long ct_count(const CuckooTable_t* ct);
+unsigned long ct_capacity(const CuckooTable_t* ct); // In slots
+const Article_t* ct_fetch(const CuckooTable_t* ct, const char* key);
+
+// Commands
+void ct_insert(CuckooTable_t* ct, const Article_t* article);
+void ct_remove(CuckooTable_t* ct, const char* key);
+
+#endif //CUCKOO_TABLE_H
@@ -0,0 +1,36 @@
+#ifndef FILE_TABLE_H
+#define FILE_TABLE_H
+
+#include <stdbool.h>
+
+#include "article.h"
+
+/*
+ * Out-of-core article table kept in a memory-mapped file
+ * Buckets are 4 KiB pages of fixed-size article records, so a lookup usually touches one page
+ * Growth is linear hashing: one bucket splits at a time and nothing is ever rebuilt wholesale
+ * Full buckets chain overflow pages kept in a companion "<path>.ovf" file
+ * All state lives in the files, so reopening a table needs no parsing
+ *
+ * Articles returned by ft_fetch point into the mapping and are only valid until the next insert or remove
+ * Files are native-endian and are not meant to move between machines
+ */
+
+typedef struct FileTable_s FileTable_t;
+
+// Constructors/Destructors
+FileTable_t* ft_open(const char* path); // Creates the table if path does not exist; NULL on failure or damaged files
+void ft_close(FileTable_t* ft);
+
+// Queries
+bool ft_contains(const FileTable_t* ft, const char* key);
+unsigned long ft_count(const FileTable_t* ft);
+unsigned long ft_bucket_count(const FileTable_t* ft);
+const Article_t* ft_fetch(const FileTable_t* ft, const char* key);
+
+// Commands
+bool ft_insert(FileTable_t* ft, const Article_t* article); // False, with the table unchanged, if the files cannot grow
+void ft_remove(FileTable_t* ft, const char* key);
+void ft_sync(FileTable_t* ft);
+
+#endif //FILE_TABLE_H
@@ -0,0 +1,31 @@
+#ifndef FROZEN_TABLE_H
+#define FROZEN_TABLE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "article.h"
+
+/*
+ * Immutable article table indexed by a minimal perfect hash (hash and displace)
+ * n articles occupy exactly n dense records; a lookup reads one displacement,
+ * one record, and compares one key
+ * The in-memory image is also the file format, so saved tables are mapped, not parsed
+ */
+
+typedef struct FrozenTable_s FrozenTable_t;
+
+// Constructors/Destructors
+FrozenTable_t* fz_build(const Article_t* const* articles, unsigned long count); // Keys must be distinct
+FrozenTable_t* fz_map(const char* path); // NULL if path is missing or not a frozen table
+void fz_delete(FrozenTable_t* fz);
+
+// Queries
+bool fz_contains(const FrozenTable_t* fz, const char* key);
+unsigned long fz_count(const FrozenTable_t* fz);
+const Article_t* fz_fetch(const FrozenTable_t* fz, const char* key);
+
+// Commands
+void fz_save(const FrozenTable_t* fz, FILE* out);
+
+#endif //FROZEN_TABLE_H
@@ -0,0 +1,247 @@
+#ifndef GENERIC_HASH_TABLE_H
+#define GENERIC_HASH_TABLE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ht_capacity.h"
+
+/*
+ * Type-specialized tables with the same behaviour as HashTable_t:
+ * linear probing, prime capacities, expansion above 75% and shrinkage below 25% density
+ *
+ * GHT_GENERATE(Name, Key, Value, hash, equal, key_copy, key_free, value_copy, value_free)
+ * defines Name_t and static inline Name_new, Name_delete, Name_insert, Name_fetch,
+ * Name_contains, Name_remove, Name_count, Name_capacity, Name_resize
+ *
+ * Keys and values are stored by value in flat arrays, and every callback is
+ * a function or macro visible at the call site, so hashing and comparison inline
+ *
+ * hash(Key) -> unsigned long long, equal(Key, Key) -> bool
+ * key_copy/value_copy(x) return what gets stored, key_free/value_free(x) release it
+ * Name_fetch returns a pointer into the table, valid until the next insert or remove
+ */
+
+enum GenericCellState
+{
+	GHT_OPEN, GHT_OCCUPIED, GHT_REMOVED
+};
+
+// Copy policies for plain data and NUL-terminated strings
+#define GHT_COPY_BY_VALUE(x) (x)
+#define GHT_FREE_NOTHING(x) ((void)(x))
+#define GHT_COPY_STRING(x) ght_duplicate_string(x)
+#define GHT_FREE_STRING(x) free((void*)(x))
+
+static inline const char* ght_duplicate_string(const char* const str)
+{
+	const size_t len = strlen(str) + 1;
+	return (const char*)memcpy(malloc(len), str, len);
+}
+
+// Same finalizer as kh_mix, repeated here so keys hash inline
+static inline unsigned long long ght_mix(unsigned long long h)
+{
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDllu;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53llu;
+	h ^= h >> 33;
+	return h;
+}
+
+static inline unsigned long long ght_hash_unsigned_long(const unsigned long key)
+{
+	return ght_mix(key);
+}
+
+// FNV-1a and the finalizer, as kh_hash_string(key, 0) computes them, but inline and in a single pass
+static inline unsigned long long ght_hash_string(const char* const key)
+{
+	unsigned long long h = 0xCBF29CE484222325llu;
+	unsigned long len = 0;
+
+	for (; key[len] != '\0'; ++len)
+	{
+		h ^= (unsigned char)key[len];
+		h *= 0x100000001B3llu;
+	}
+
+	return ght_mix(h ^ len);
+}
+
+#define GHT_EQUAL_SCALAR(a, b) ((a) == (b))
+#define GHT_EQUAL_STRING(a, b) (strcmp((a), (b)) == 0)
+
+#define GHT_GENERATE(Name, Key, Value, hash, equal, key_copy, key_free, value_copy, value_free)                    \
+                                                                                                                    \
+typedef Key Name##_key_t;                                                                                           \
+typedef Value Name##_value_t;                                                                                       \
+                                                                                                                    \
+typedef struct Name##_s                                                                                             \
+{                                                                                                                   \
+	unsigned long count;                                                                                            \
+	unsigned long removed;                                                                                          \
+	unsigned long capacity;                                                                                         \
+	unsigned short capacity_index;                                                                                  \
+	unsigned char* states;                                                                                          \
+	Name##_key_t* keys;                                                                                             \
+	Name##_value_t* values;                                                                                         \
+} Name##_t;                                                                                                         \
+                                                                                                                    \
+static inline void Name##_alloc_slots(Name##_t* const t)                                                            \
+{                                                                                                                   \
+	/* GHT_OPEN is zero, so zeroed memory is an empty table */                                                      \
+	t->states = (unsigned char*)calloc(t->capacity, sizeof(unsigned char));                                         \
+	t->keys = (Name##_key_t*)malloc(t->capacity * sizeof(Name##_key_t));                                            \
+	t->values = (Name##_value_t*)malloc(t->capacity * sizeof(Name##_value_t));                                      \
+}                                                                                                                   \
+                                                                                                                    \
+static inline void Name##_free_slots(Name##_t* const t, const bool free_items)                                      \
+{                                                                                                                   \
+	for (unsigned long i = 0; free_items && i < t->capacity; ++i)                                                   \
+	{                                                                                                               \
+		if (t->states[i] == GHT_OCCUPIED)                                                                           \
+		{                                                                                                           \
+			key_free(t->keys[i]);                                                                                   \
+			value_free(t->values[i]);                                                                               \
+		}                                                                                                           \
+	}                                                                                                               \
+                                                                                                                    \
+	free(t->states);                                                                                                \
+	free(t->keys);                                                                                                  \
+	free(t->values);                                                                                                \
+}                                                                                                                   \
+                                                                                                                    \
+static inline Name##_t* Name##_new(void)                                                                            \
+{                                                                                                                   \
+	Name##_t* const t = (Name##_t*)malloc(sizeof(Name##_t));                                                        \
+	t->count = 0;                                                                                                   \
+	t->removed = 0;                                                                                                 \
+	t->capacity_index = 0;                                                                                          \
+	t->capacity = calculate_optimal_capacity_for_index(0);                                                          \
+	Name##_alloc_slots(t);                                                                                          \
+	return t;                                                                                                       \
+}                                                                                                                   \
+                                                                                                                    \
+static inline void Name##_delete(Name##_t* const t)                                                                 \
+{                                                                                                                   \
+	Name##_free_slots(t, true);                                                                                     \
+	free(t);                                                                                                        \
+}                                                                                                                   \
+                                                                                                                    \
+static inline unsigned long Name##_count(const Name##_t* const t)                                                   \
+{                                                                                                                   \
+	return t->count;                                                                                                \
+}                                                                                                                   \
+                                                                                                                    \
+static inline unsigned long Name##_capacity(const Name##_t* const t)                                                \
+{                                                                                                                   \
+	return t->capacity;                                                                                             \
+}                                                                                                                   \
+                                                                                                                    \
+/* Returns the index holding key, or the capacity if there is none */                                               \
+static inline unsigned long Name##_find_index_of_key(const Name##_t* const t, const Name##_key_t key)               \
+{                                                                                                                   \
+	const unsigned long hashed_index = (unsigned long)(hash(key) % t->capacity);                                    \
+	unsigned long i = hashed_index;                                                                                 \
+                                                                                                                    \
+	do                                                                                                              \
+	{                                                                                                               \
+		if (t->states[i] == GHT_OPEN)                                                                               \
+			break;                                                                                                  \
+                                                                                                                    \
+		if (t->states[i] == GHT_OCCUPIED && equal(t->keys[i], key))                                                 \
+			return i;                                                                                               \
+                                                                                                                    \
+		i = (i + 1) % t->capacity;                                                                                  \
+                                                                                                                    \
+	} while (i != hashed_index);                                                                                    \
+                                                                                                                    \
+	return t->capacity;                                                                                             \
+}                                                                                                                   \
+                                                                                                                    \
+static inline bool Name##_contains(const Name##_t* const t, const Name##_key_t key)                                 \
+{                                                                                                                   \
+	return Name##_find_index_of_key(t, key) != t->capacity;                                                         \
+}                                                                                                                   \
+                                                                                                                    \
+static inline Name##_value_t* Name##_fetch(const Name##_t* const t, const Name##_key_t key)                         \
+{                                                                                                                   \
+	const unsigned long i = Name##_find_index_of_key(t, key);                                                       \
+	return i != t->capacity ? &t->values[i] : NULL;                                                                 \
+}                                                                                                                   \
+                                                                                                                    \
+/* Places an owned key/value pair known to be absent; used by insert and by resize, which moves instead of copying */ \
+static inline void Name##_place(Name##_t* const t, const Name##_key_t key, const Name##_value_t value)              \
+{                                                                                                                   \
+	unsigned long i = (unsigned long)(hash(key) % t->capacity);                                                     \
+                                                                                                                    \
+	while (t->states[i] == GHT_OCCUPIED)                                                                            \
+		i = (i + 1) % t->capacity;                                                                                  \
+                                                                                                                    \
+	if (t->states[i] == GHT_REMOVED)                                                                                \
+		t->removed--;                                                                                               \
+                                                                                                                    \
+	t->keys[i] = key;                                                                                               \
+	t->values[i] = value;                                                                                           \
+	t->states[i] = GHT_OCCUPIED;                                                                                    \
+	t->count++;                                                                                                     \
+}                                                                                                                   \
+                                                                                                                    \
+static inline void Name##_resize(Name##_t* const t, const unsigned long new_capacity)                               \
+{                                                                                                                   \
+	if (new_capacity == 0 || new_capacity < t->count)                                                               \
+		return;                                                                                                     \
+                                                                                                                    \
+	Name##_t old_table = *t;                                                                                        \
+	t->count = 0;                                                                                                   \
+	t->removed = 0;                                                                                                 \
+	t->capacity = new_capacity;                                                                                     \
+	Name##_alloc_slots(t);                                                                                          \
+                                                                                                                    \
+	for (unsigned long i = 0; i < old_table.capacity; ++i)                                                          \
+		if (old_table.states[i] == GHT_OCCUPIED)                                                                    \
+			Name##_place(t, old_table.keys[i], old_table.values[i]);                                                \
+                                                                                                                    \
+	Name##_free_slots(&old_table, false);                                                                           \
+}                                                                                                                   \
+                                                                                                                    \
+static inline void Name##_insert(Name##_t* const t, const Name##_key_t key, const Name##_value_t value)             \
+{                                                                                                                   \
+	const unsigned long i = Name##_find_index_of_key(t, key);                                                       \
+                                                                                                                    \
+	if (i != t->capacity)                                                                                           \
+	{                                                                                                               \
+		value_free(t->values[i]);                                                                                   \
+		t->values[i] = value_copy(value);                                                                           \
+		return;                                                                                                     \
+	}                                                                                                               \
+                                                                                                                    \
+	if ((double)(t->count + 1) / t->capacity > 0.75 && t->capacity_index != maximum_capacity_index())               \
+		Name##_resize(t, calculate_optimal_capacity_for_index(++t->capacity_index));                                \
+	else if ((double)(t->count + t->removed + 1) / t->capacity > 0.75)                                              \
+		Name##_resize(t, t->capacity);                                                                              \
+                                                                                                                    \
+	Name##_place(t, key_copy(key), value_copy(value));                                                              \
+}                                                                                                                   \
+                                                                                                                    \
+static inline void Name##_remove(Name##_t* const t, const Name##_key_t key)                                         \
+{                                                                                                                   \
+	const unsigned long i = Name##_find_index_of_key(t, key);                                                       \
+                                                                                                                    \
+	if (i == t->capacity)                                                                                           \
+		return;                                                                                                     \
+                                                                                                                    \
+	key_free(t->keys[i]);                                                                                           \
+	value_free(t->values[i]);                                                                                       \
+	t->states[i] = GHT_REMOVED;                                                                                     \
+	t->count--;                                                                                                     \
+	t->removed++;                                                                                                   \
+                                                                                                                    \
+	if ((double)t->count / t->capacity < 0.25 && t->capacity_index != 0)                                            \
+		Name##_resize(t, calculate_optimal_capacity_for_index(--t->capacity_index));                                \
+}
+
+#endif //GENERIC_HASH_TABLE_H
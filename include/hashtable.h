@@ -5,13 +5,70 @@
 #include <stdio.h>
 
 #include "article.h"
+#include "frozen_table.h"
+#include "ht_stats.h"
 
 typedef struct HashTable_s HashTable_t;
 
+// Called by ht_cache_fetch on a miss; returns a make_article result, or NULL if the key is unknown
+// The table stores a copy and deletes the returned article
+typedef Article_t* (* ht_loader_t)(const char* key, void* context);
+
+// Bytes requested from the allocator, without its own bookkeeping
+typedef struct HtMemoryUsage_s
+{
+	unsigned long slots; // Item and state arrays, rounded up to whole huge pages when mapped
+	unsigned long metadata; // Table header, membership filter, cache state
+	unsigned long articles;
+	unsigned long total;
+} HtMemoryUsage_t;
+
+typedef enum HtMergePolicy_e
+{
+	HT_MERGE_KEEP_DESTINATION, // Keys in both tables keep the destination's article
+	HT_MERGE_TAKE_SOURCE // Keys in both tables get the source's article
+} HtMergePolicy_t;
+
+// Articles are borrowed from the compared tables and stay valid until those tables change
+typedef struct HtDiff_s
+{
+	const Article_t** added; // In b only
+	unsigned long added_count;
+	const Article_t** removed; // In a only
+	unsigned long removed_count;
+	const Article_t** changed; // In both but not articles_are_equal; b's version
+	unsigned long changed_count;
+} HtDiff_t;
+
+// Where a key sits in one table, computed ahead of a lookup; see ht_key_hash
+// Stale once the table resizes or reseeds, in which case the lookup simply hashes again
+typedef struct HtKeyHash_s
+{
+	unsigned long slot;
+	unsigned long long filter_hash;
+	unsigned long generation;
+} HtKeyHash_t;
+
+typedef struct HashTableOptions_s
+{
+	bool membership_filter; // Keeps a counting filter in sync so most misses skip the probe chain
+	bool seeded_hash; // Keyed SipHash with a random per-table seed, for keys from untrusted sources
+
+	// Cache mode: when either limit is set, inserting past it evicts with CLOCK (approximate LRU)
+	unsigned long max_items;
+	unsigned long max_bytes; // Article storage only, see article_footprint
+	ht_loader_t loader;
+	void* loader_context;
+
+	bool huge_pages; // Slot arrays of 2 MB and up live in their own huge-page mappings
+} HashTableOptions_t;
+
 // Constructors/Destructors
 HashTable_t* ht_new(void);
+HashTable_t* ht_new_with_options(const HashTableOptions_t* options);
 HashTable_t* ht_from_file(FILE* in);
 void ht_delete(HashTable_t* ht);
+void ht_free_diff(HtDiff_t* diff);
 
 // Queries
 bool ht_is_empty(const HashTable_t* ht);
@@ -20,12 +77,31 @@ unsigned long ht_count(const HashTable_t* ht);
 unsigned long ht_capacity(const HashTable_t* ht);
 const Article_t* ht_fetch(const HashTable_t* ht, const char* key);
 
+// Keys as borrowed spans of len bytes, not NUL-terminated; lookups neither copy nor allocate
+bool ht_contains_n(const HashTable_t* ht, const char* key, unsigned long len);
+const Article_t* ht_fetch_n(const HashTable_t* ht, const char* key, unsigned long len);
+HtKeyHash_t ht_key_hash(const HashTable_t* ht, const char* key, unsigned long len);
+const Article_t* ht_fetch_hashed(const HashTable_t* ht, const char* key, unsigned long len, HtKeyHash_t hash);
+
+bool ht_is_seeded(const HashTable_t* ht); // Also true once a suspiciously long probe made the table switch
+unsigned long ht_cache_hits(const HashTable_t* ht);
+unsigned long ht_cache_misses(const HashTable_t* ht);
+unsigned long ht_cache_evictions(const HashTable_t* ht);
+void ht_read_stats(const HashTable_t* ht, HtStats_t* out); // All zeroes unless built with HT_INSTRUMENTATION
+FrozenTable_t* ht_freeze(const HashTable_t* ht); // Read-only copy with one-probe lookups, see frozen_table.h
+HtMemoryUsage_t ht_memory_usage(const HashTable_t* ht);
+HtDiff_t ht_diff(const HashTable_t* a, const HashTable_t* b); // Lookups run on several threads for big tables
+
 // Commands
 void ht_insert(HashTable_t* ht, const Article_t* article);
+const Article_t* ht_cache_fetch(HashTable_t* ht, const char* key);
 void ht_remove(HashTable_t* ht, const char* key);
+void ht_remove_n(HashTable_t* ht, const char* key, unsigned long len);
 void ht_resize(HashTable_t* ht, unsigned long new_capacity);
 void ht_expand(HashTable_t* ht);
 void ht_shrink(HashTable_t* ht);
+void ht_merge(HashTable_t* dst, HashTable_t* src, HtMergePolicy_t policy); // Moves src's articles, leaving it empty
+void ht_compact(HashTable_t* ht); // Smallest capacity within the load bounds, no tombstones, articles packed in slot order
 void ht_display_states(const HashTable_t* ht, FILE* out);
 void ht_dump(const HashTable_t* ht, FILE* out);
 
@@ -0,0 +1,10 @@
+#ifndef HT_CAPACITY_H
+#define HT_CAPACITY_H
+
+// Prime capacities shared by every table in the family, roughly doubling with each index
+
+// Queries
+unsigned long calculate_optimal_capacity_for_index(unsigned short index);
+unsigned short maximum_capacity_index(void);
+
+#endif //HT_CAPACITY_H
@@ -0,0 +1,82 @@
+#ifndef HT_STATS_H
+#define HT_STATS_H
+
+// Bucket i counts operations that took between 2^i and 2^(i+1) - 1 nanoseconds
+#define HT_LATENCY_BUCKETS 40
+
+typedef enum HtOperation
+{
+	HT_OP_INSERT, HT_OP_FETCH, HT_OP_REMOVE, HT_OP_RESIZE, HT_OP_LOAD, HT_OP_COUNT
+} HtOperation_t;
+
+typedef struct HtOperationStats_s
+{
+	unsigned long long calls;
+	unsigned long long probes;
+	unsigned long long allocations;
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+	unsigned long long latency_histogram[HT_LATENCY_BUCKETS];
+} HtOperationStats_t;
+
+typedef struct HtStats_s
+{
+	HtOperationStats_t operations[HT_OP_COUNT];
+} HtStats_t;
+
+/*
+ * Instrumentation is only compiled in when HT_INSTRUMENTATION is defined
+ * Otherwise every macro below expands to nothing and tables carry no extra state
+ *
+ * Counters live in one shard per (table, thread), each on its own cache lines,
+ * so threads never write to a line another thread is counting on
+ * Operations started while a resize or load is running are folded into it:
+ * a resize shows up as a single pause, not as thousands of inserts
+ */
+#ifdef HT_INSTRUMENTATION
+
+typedef struct HtStatsRegistry_s HtStatsRegistry_t;
+typedef struct HtStatsShard_s HtStatsShard_t;
+
+typedef struct HtStatsScope_s
+{
+	HtStatsShard_t* shard;
+	HtOperation_t previous;
+	unsigned long long start_ns;
+	int recorded;
+} HtStatsScope_t;
+
+// Constructors/Destructors
+HtStatsRegistry_t* ht_stats_new_registry(void);
+void ht_stats_delete_registry(HtStatsRegistry_t* registry);
+
+// Queries
+void ht_stats_collect(const HtStatsRegistry_t* registry, HtStats_t* out);
+
+// Commands
+HtStatsScope_t ht_stats_begin(HtStatsRegistry_t* registry, HtOperation_t operation);
+void ht_stats_end(HtStatsScope_t* scope);
+void ht_stats_add_probes(HtStatsRegistry_t* registry, unsigned long probes);
+void ht_stats_add_allocations(HtStatsRegistry_t* registry, unsigned long allocations);
+
+#define HT_STATS_FIELD HtStatsRegistry_t* stats;
+#define HT_STATS_INIT(ht) ((ht)->stats = ht_stats_new_registry())
+#define HT_STATS_FREE(ht) ht_stats_delete_registry((ht)->stats)
+#define HT_STATS_BEGIN(ht, operation) HtStatsScope_t ht_stats_scope_ = ht_stats_begin((ht)->stats, operation)
+#define HT_STATS_END() ht_stats_end(&ht_stats_scope_)
+#define HT_STATS_PROBES(ht, n) ht_stats_add_probes((ht)->stats, n)
+#define HT_STATS_ALLOCATIONS(ht, n) ht_stats_add_allocations((ht)->stats, n)
+
+#else
+
+#define HT_STATS_FIELD
+#define HT_STATS_INIT(ht) ((void)0)
+#define HT_STATS_FREE(ht) ((void)0)
+#define HT_STATS_BEGIN(ht, operation) ((void)0)
+#define HT_STATS_END() ((void)0)
+#define HT_STATS_PROBES(ht, n) ((void)0)
+#define HT_STATS_ALLOCATIONS(ht, n) ((void)0)
+
+#endif //HT_INSTRUMENTATION
+
+#endif //HT_STATS_H
@@ -0,0 +1,27 @@
+#ifndef KEY_HASH_H
+#define KEY_HASH_H
+
+/*
+ * Capacity-independent 64-bit key hashes
+ * ht_hash_key maps keys straight to slots of one capacity; these are for
+ * structures that need a stable hash, such as filters and on-disk layouts
+ */
+
+// 128-bit secret for keyed hashing; without it, colliding keys cannot be computed offline
+typedef struct KeyHashSeed_s
+{
+	unsigned long long k0;
+	unsigned long long k1;
+} KeyHashSeed_t;
+
+// Constructors/Destructors
+KeyHashSeed_t kh_random_seed(void);
+
+// Queries
+unsigned long long kh_hash_bytes(const char* key, unsigned long len, unsigned long long seed);
+unsigned long long kh_hash_string(const char* key, unsigned long long seed);
+unsigned long long kh_mix(unsigned long long h);
+unsigned long long kh_siphash_bytes(const char* key, unsigned long len, const KeyHashSeed_t* seed);
+unsigned long long kh_siphash_string(const char* key, const KeyHashSeed_t* seed);
+
+#endif //KEY_HASH_H
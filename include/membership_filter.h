@@ -0,0 +1,26 @@
+#ifndef MEMBERSHIP_FILTER_H
+#define MEMBERSHIP_FILTER_H
+
+#include <stdbool.h>
+
+/*
+ * Counting blocked Bloom filter
+ * All counters of one key share a single 64-byte block, so a query touches one cache line
+ * Counters are 4 bits wide: keys can be removed, and saturated counters stay put
+ */
+
+typedef struct MembershipFilter_s MembershipFilter_t;
+
+// Constructors/Destructors
+MembershipFilter_t* mf_new(unsigned long expected_items);
+void mf_delete(MembershipFilter_t* filter);
+
+// Queries
+bool mf_may_contain(const MembershipFilter_t* filter, unsigned long long hash);
+unsigned long mf_size_in_bytes(const MembershipFilter_t* filter);
+
+// Commands
+void mf_add(MembershipFilter_t* filter, unsigned long long hash);
+void mf_remove(MembershipFilter_t* filter, unsigned long long hash);
+
+#endif //MEMBERSHIP_FILTER_H
@@ -0,0 +1,26 @@
+#ifndef SLOT_MEMORY_H
+#define SLOT_MEMORY_H
+
+#include <stdbool.h>
+
+/*
+ * Zeroed storage for slot arrays
+ * Arrays of at least SM_HUGE_PAGE_SIZE can be backed by fresh anonymous mappings advised
+ * to use transparent huge pages: fewer TLB misses on random probes, zeroing done by the kernel
+ * on first touch instead of by a loop, and the memory goes straight back to the OS when freed
+ */
+
+#define SM_HUGE_PAGE_SIZE (2lu * 1024 * 1024)
+
+typedef struct SlotMemory_s
+{
+	void* base;
+	unsigned long size;
+	bool mapped;
+} SlotMemory_t;
+
+// Constructors/Destructors
+SlotMemory_t sm_alloc_zeroed(unsigned long bytes, bool huge_pages); // Falls back to calloc when mapping fails
+void sm_free(SlotMemory_t memory);
+
+#endif //SLOT_MEMORY_H
@@ -1,6 +1,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "article.h"
 
@@ -51,6 +52,16 @@ void delete_article(Article_t* const a)
 	free(a);
 }
 
+Article_t* make_article_block(const unsigned long count)
+{
+	return (Article_t*)malloc(count * sizeof(Article_t));
+}
+
+void delete_article_block(Article_t* const block)
+{
+	free(block);
+}
+
 const char* key_of(const Article_t* const article)
 {
 	return article->doi;
@@ -61,11 +72,31 @@ bool strings_equal_up_to(const char* const str_a, const char* const str_b, const
 	return strncmp(str_a, str_b, len) == 0;
 }
 
+unsigned long key_length_of(const Article_t* const article)
+{
+	// Keys that fill the field are stored without a terminator
+	return strnlen(article->doi, MAX_STR_FIELD_LEN);
+}
+
+unsigned long stored_key_length(const unsigned long len)
+{
+	return len < MAX_STR_FIELD_LEN ? len : MAX_STR_FIELD_LEN;
+}
+
 bool article_has_key(const Article_t* const article, const char* const key)
 {
 	return strings_equal_up_to(article->doi, key, MAX_STR_FIELD_LEN);
 }
 
+bool article_has_key_n(const Article_t* const article, const char* const key, const unsigned long len)
+{
+	// Same answer as article_has_key on a terminated copy of key, down to comparing at most one field's worth
+	if (len >= MAX_STR_FIELD_LEN)
+		return strings_equal_up_to(article->doi, key, MAX_STR_FIELD_LEN);
+
+	return strings_equal_up_to(article->doi, key, (unsigned)len) && article->doi[len] == '\0';
+}
+
 bool articles_are_equal(const Article_t* const a, const Article_t* const b)
 {
 	if (!article_has_key(a, key_of(b)))
@@ -79,6 +110,28 @@ bool articles_are_equal(const Article_t* const a, const Article_t* const b)
 	return true;
 }
 
+unsigned long article_footprint(void)
+{
+	return sizeof(Article_t);
+}
+
+Article_t* article_in_block(Article_t* const block, const unsigned long i)
+{
+	return &block[i];
+}
+
+bool article_is_in_block(const Article_t* const block, const unsigned long count, const Article_t* const article)
+{
+	// Integer comparison: ordering pointers into different objects is undefined
+	const uintptr_t first = (uintptr_t)block, address = (uintptr_t)article;
+	return block != NULL && address >= first && address < first + count * sizeof(Article_t);
+}
+
+const Article_t* article_view_of_record(const void* const record)
+{
+	return (const Article_t*)record;
+}
+
 void display_article(const Article_t* article, FILE* out)
 {
 	fprintf(out,
@@ -114,3 +167,20 @@ void dump_article(const Article_t* article, FILE* out)
 	fprintf(out, "%s\n", article->author);
 	fprintf(out, "%u\n", article->year);
 }
+
+void copy_article(const Article_t* const original, Article_t* const target)
+{
+	copy_values_to_structure(target, original->doi, original->title, original->author, original->year);
+}
+
+void article_to_record(const Article_t* const article, void* const record)
+{
+	// Fields hold uninitialised bytes past their terminators, which must not reach the file
+	Article_t* const image = (Article_t*)record;
+	memset(image, 0, sizeof(Article_t));
+
+	strncpy(image->doi, article->doi, MAX_STR_FIELD_LEN);
+	strncpy(image->title, article->title, MAX_STR_FIELD_LEN);
+	strncpy(image->author, article->author, MAX_STR_FIELD_LEN);
+	image->year = article->year;
+}
@@ -0,0 +1,580 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "article.h"
+#include "hashtable.h"
+#include "cuckoo_table.h"
+
+#define DOI_BUFFER_LEN 32
+
+static const unsigned long DEFAULT_ITEM_COUNT = 20000;
+static const unsigned long DEFAULT_OPERATION_COUNT = 200000;
+static const double ZIPF_EXPONENT = 0.99;
+
+typedef struct BenchConfig_s
+{
+	unsigned long items;
+	unsigned long operations;
+	bool json;
+} BenchConfig_t;
+
+typedef struct BenchResult_s
+{
+	const char* workload;
+	unsigned long items;
+	unsigned long operations;
+	double total_ns;
+	unsigned long capacity;
+	long peak_rss_kb;
+} BenchResult_t;
+
+typedef struct Dataset_s
+{
+	unsigned long count;
+	Article_t** articles;
+	char (* missing_keys)[DOI_BUFFER_LEN];
+	double* zipf_cdf;
+} Dataset_t;
+
+// Results are accumulated here so a misbehaving compiler cannot drop the lookups
+volatile unsigned long bench_sink;
+
+unsigned long long random_state = 0x9E3779B97F4A7C15llu;
+
+unsigned long long next_random(void)
+{
+	// xorshift64*: deterministic across runs so commits can be compared
+	random_state ^= random_state >> 12;
+	random_state ^= random_state << 25;
+	random_state ^= random_state >> 27;
+	return random_state * 0x2545F4914F6CDD1Dllu;
+}
+
+double next_unit_random(void)
+{
+	return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void make_doi(char* const buffer, const unsigned long registrant, const unsigned long item)
+{
+	// Mimics real DOIs: few registrants, long runs of sequential suffixes
+	snprintf(buffer, DOI_BUFFER_LEN, "10.%04lu/abc.%07lu", 1000 + registrant, item);
+}
+
+double* build_zipf_cdf(const unsigned long count)
+{
+	double* const cdf = (double*)malloc(count * sizeof(double));
+	double sum = 0;
+
+	for (unsigned long i = 0; i < count; ++i)
+		cdf[i] = sum += 1.0 / pow((double)(i + 1), ZIPF_EXPONENT);
+
+	for (unsigned long i = 0; i < count; ++i)
+		cdf[i] /= sum;
+
+	return cdf;
+}
+
+unsigned long next_zipf_rank(const Dataset_t* const data)
+{
+	const double u = next_unit_random();
+	unsigned long low = 0, high = data->count - 1;
+
+	while (low < high)
+	{
+		const unsigned long mid = low + (high - low) / 2;
+		if (data->zipf_cdf[mid] < u)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+Dataset_t make_dataset(const unsigned long count)
+{
+	Dataset_t data = { count, NULL, NULL, NULL };
+	char doi[DOI_BUFFER_LEN];
+
+	data.articles = (Article_t**)malloc(count * sizeof(Article_t*));
+	data.missing_keys = malloc(count * sizeof *data.missing_keys);
+
+	for (unsigned long i = 0; i < count; ++i)
+	{
+		make_doi(doi, i % 16, i);
+		data.articles[i] = make_article(doi, "Synthetic title", "Synthetic author", 1990 + i % 35);
+		make_doi(data.missing_keys[i], 16 + i % 16, i);
+	}
+
+	// Shuffle so insertion order does not follow key order
+	for (unsigned long i = count - 1; i > 0; --i)
+	{
+		const unsigned long j = next_random() % (i + 1);
+		Article_t* const tmp = data.articles[i];
+		data.articles[i] = data.articles[j];
+		data.articles[j] = tmp;
+	}
+
+	data.zipf_cdf = build_zipf_cdf(count);
+
+	return data;
+}
+
+void delete_dataset(Dataset_t* const data)
+{
+	for (unsigned long i = 0; i < data->count; ++i)
+		delete_article(data->articles[i]);
+
+	free(data->articles);
+	free(data->missing_keys);
+	free(data->zipf_cdf);
+}
+
+HashTable_t* table_with_dataset_and_options(const Dataset_t* const data, const HashTableOptions_t* const options)
+{
+	HashTable_t* const ht = ht_new_with_options(options);
+
+	for (unsigned long i = 0; i < data->count; ++i)
+		ht_insert(ht, data->articles[i]);
+
+	return ht;
+}
+
+HashTable_t* table_with_dataset(const Dataset_t* const data)
+{
+	static const HashTableOptions_t default_options = { false };
+	return table_with_dataset_and_options(data, &default_options);
+}
+
+// Any table the fetch workloads can run against, behind the three calls they need
+typedef struct FetchTable_s
+{
+	void* table;
+	const Article_t* (* fetch)(void* table, const char* key);
+	unsigned long (* capacity)(const void* table);
+	void (* destroy)(void* table);
+} FetchTable_t;
+
+typedef FetchTable_t (* TableFactory_t)(const Dataset_t* data);
+typedef const char* (* KeyPicker_t)(const Dataset_t* data);
+
+const Article_t* fetch_from_hash_table(void* const table, const char* const key)
+{
+	return ht_fetch((const HashTable_t*)table, key);
+}
+
+const Article_t* fetch_through_cache(void* const table, const char* const key)
+{
+	return ht_cache_fetch((HashTable_t*)table, key);
+}
+
+unsigned long capacity_of_hash_table(const void* const table)
+{
+	return ht_capacity((const HashTable_t*)table);
+}
+
+void delete_hash_table(void* const table)
+{
+	ht_delete((HashTable_t*)table);
+}
+
+const Article_t* fetch_from_frozen_table(void* const table, const char* const key)
+{
+	return fz_fetch((const FrozenTable_t*)table, key);
+}
+
+unsigned long capacity_of_frozen_table(const void* const table)
+{
+	return fz_count((const FrozenTable_t*)table);
+}
+
+void delete_frozen_table(void* const table)
+{
+	fz_delete((FrozenTable_t*)table);
+}
+
+const Article_t* fetch_from_cuckoo_table(void* const table, const char* const key)
+{
+	return ct_fetch((const CuckooTable_t*)table, key);
+}
+
+unsigned long capacity_of_cuckoo_table(const void* const table)
+{
+	return ct_capacity((const CuckooTable_t*)table);
+}
+
+void delete_cuckoo_table(void* const table)
+{
+	ct_delete((CuckooTable_t*)table);
+}
+
+FetchTable_t hash_table_with_options(const Dataset_t* const data, const HashTableOptions_t* const options)
+{
+	const FetchTable_t table = {
+			table_with_dataset_and_options(data, options), fetch_from_hash_table, capacity_of_hash_table, delete_hash_table
+	};
+	return table;
+}
+
+FetchTable_t plain_table(const Dataset_t* const data)
+{
+	static const HashTableOptions_t options = { false };
+	return hash_table_with_options(data, &options);
+}
+
+FetchTable_t filtered_table(const Dataset_t* const data)
+{
+	static const HashTableOptions_t options = { .membership_filter = true };
+	return hash_table_with_options(data, &options);
+}
+
+FetchTable_t seeded_table(const Dataset_t* const data)
+{
+	static const HashTableOptions_t options = { .seeded_hash = true };
+	return hash_table_with_options(data, &options);
+}
+
+FetchTable_t huge_page_table(const Dataset_t* const data)
+{
+	static const HashTableOptions_t options = { .huge_pages = true };
+	return hash_table_with_options(data, &options);
+}
+
+Article_t* load_synthetic_article(const char* const key, void* const context)
+{
+	(void)context;
+	return make_article(key, "Synthetic title", "Synthetic author", 2000);
+}
+
+FetchTable_t cache_table(const Dataset_t* const data)
+{
+	// Starts empty, holds a tenth of the dataset and reads misses through a loader
+	const HashTableOptions_t options = { .max_items = data->count / 10 + 1, .loader = load_synthetic_article };
+	const FetchTable_t table = {
+			ht_new_with_options(&options), fetch_through_cache, capacity_of_hash_table, delete_hash_table
+	};
+	return table;
+}
+
+FetchTable_t frozen_table(const Dataset_t* const data)
+{
+	HashTable_t* const ht = table_with_dataset(data);
+	const FetchTable_t table = { ht_freeze(ht), fetch_from_frozen_table, capacity_of_frozen_table, delete_frozen_table };
+	ht_delete(ht);
+	return table;
+}
+
+FetchTable_t cuckoo_table(const Dataset_t* const data)
+{
+	const FetchTable_t table = { ct_new(), fetch_from_cuckoo_table, capacity_of_cuckoo_table, delete_cuckoo_table };
+
+	for (unsigned long i = 0; i < data->count; ++i)
+		ct_insert((CuckooTable_t*)table.table, data->articles[i]);
+
+	return table;
+}
+
+const char* pick_hit_uniform(const Dataset_t* const data)
+{
+	return key_of(data->articles[next_random() % data->count]);
+}
+
+const char* pick_hit_zipf(const Dataset_t* const data)
+{
+	return key_of(data->articles[next_zipf_rank(data)]);
+}
+
+const char* pick_miss_uniform(const Dataset_t* const data)
+{
+	return data->missing_keys[next_random() % data->count];
+}
+
+const char* pick_miss_zipf(const Dataset_t* const data)
+{
+	return data->missing_keys[next_zipf_rank(data)];
+}
+
+typedef struct Workload_s Workload_t;
+
+struct Workload_s
+{
+	const char* name;
+	BenchResult_t (* run)(const Workload_t* workload, const BenchConfig_t* config, const Dataset_t* data);
+	TableFactory_t make_table; // Fetch workloads only
+	KeyPicker_t pick_key; // Fetch workloads only
+};
+
+BenchResult_t make_result(
+		const Workload_t* const workload, const BenchConfig_t* const config,
+		const unsigned long operations, const double total_ns, const unsigned long capacity)
+{
+	BenchResult_t result = { workload->name, config->items, operations, total_ns, capacity, 0 };
+	return result;
+}
+
+BenchResult_t run_fetches(const Workload_t* const workload, const BenchConfig_t* const config, const Dataset_t* const data)
+{
+	const FetchTable_t table = workload->make_table(data);
+	unsigned long found = 0;
+
+	// Zipf picks cost a binary search each, so keys are picked up front and only the fetches are timed
+	const char** const keys = (const char**)malloc(config->operations * sizeof(const char*));
+	for (unsigned long op = 0; op < config->operations; ++op)
+		keys[op] = workload->pick_key(data);
+
+	const double start = now_ns();
+	for (unsigned long op = 0; op < config->operations; ++op)
+		found += table.fetch(table.table, keys[op]) != NULL;
+	const double elapsed = now_ns() - start;
+
+	free(keys);
+	bench_sink += found;
+	const BenchResult_t result = make_result(workload, config, config->operations, elapsed, table.capacity(table.table));
+	table.destroy(table.table);
+	return result;
+}
+
+BenchResult_t bench_insert_growth(const Workload_t* const workload, const BenchConfig_t* const config, const Dataset_t* const data)
+{
+	HashTable_t* const ht = ht_new();
+
+	// Starts from the smallest capacity, so every ht_expand step is paid for
+	const double start = now_ns();
+	for (unsigned long i = 0; i < data->count; ++i)
+		ht_insert(ht, data->articles[i]);
+	const double elapsed = now_ns() - start;
+
+	const BenchResult_t result = make_result(workload, config, data->count, elapsed, ht_capacity(ht));
+	ht_delete(ht);
+	return result;
+}
+
+BenchResult_t bench_insert_remove_churn(
+		const Workload_t* const workload, const BenchConfig_t* const config, const Dataset_t* const data)
+{
+	HashTable_t* const ht = ht_new();
+	const unsigned long resident = data->count / 2;
+
+	for (unsigned long i = 0; i < resident; ++i)
+		ht_insert(ht, data->articles[i]);
+
+	// Sliding window: each step inserts one new article and removes the oldest one
+	const double start = now_ns();
+	for (unsigned long op = 0; op < config->operations / 2; ++op)
+	{
+		const unsigned long newest = (resident + op) % data->count;
+		const unsigned long oldest = op % data->count;
+		ht_insert(ht, data->articles[newest]);
+		ht_remove(ht, key_of(data->articles[oldest]));
+	}
+	const double elapsed = now_ns() - start;
+
+	const BenchResult_t result = make_result(workload, config, config->operations / 2 * 2, elapsed, ht_capacity(ht));
+	ht_delete(ht);
+	return result;
+}
+
+BenchResult_t bench_dump(const Workload_t* const workload, const BenchConfig_t* const config, const Dataset_t* const data)
+{
+	HashTable_t* const ht = table_with_dataset(data);
+	FILE* const fp = tmpfile();
+
+	const double start = now_ns();
+	ht_dump(ht, fp);
+	fflush(fp);
+	const double elapsed = now_ns() - start;
+
+	fclose(fp);
+	const BenchResult_t result = make_result(workload, config, data->count, elapsed, ht_capacity(ht));
+	ht_delete(ht);
+	return result;
+}
+
+BenchResult_t bench_from_file(const Workload_t* const workload, const BenchConfig_t* const config, const Dataset_t* const data)
+{
+	HashTable_t* ht = table_with_dataset(data);
+	FILE* const fp = tmpfile();
+
+	ht_dump(ht, fp);
+	ht_delete(ht);
+	rewind(fp);
+
+	const double start = now_ns();
+	ht = ht_from_file(fp);
+	const double elapsed = now_ns() - start;
+
+	fclose(fp);
+	const BenchResult_t result = make_result(workload, config, data->count, elapsed, ht_capacity(ht));
+	ht_delete(ht);
+	return result;
+}
+
+static const Workload_t workloads[] =
+		{
+				{ "fetch_hit_uniform", run_fetches, plain_table, pick_hit_uniform },
+				{ "fetch_hit_zipf", run_fetches, plain_table, pick_hit_zipf },
+				{ "fetch_miss_uniform", run_fetches, plain_table, pick_miss_uniform },
+				{ "fetch_miss_zipf", run_fetches, plain_table, pick_miss_zipf },
+				{ "fetch_hit_uniform_filtered", run_fetches, filtered_table, pick_hit_uniform },
+				{ "fetch_miss_uniform_filtered", run_fetches, filtered_table, pick_miss_uniform },
+				{ "fetch_hit_uniform_seeded", run_fetches, seeded_table, pick_hit_uniform },
+				{ "fetch_hit_uniform_huge_pages", run_fetches, huge_page_table, pick_hit_uniform },
+				{ "cache_zipf", run_fetches, cache_table, pick_hit_zipf },
+				{ "frozen_fetch_hit_uniform", run_fetches, frozen_table, pick_hit_uniform },
+				{ "cuckoo_fetch_hit_uniform", run_fetches, cuckoo_table, pick_hit_uniform },
+				{ "cuckoo_fetch_miss_uniform", run_fetches, cuckoo_table, pick_miss_uniform },
+				{ "insert_growth", bench_insert_growth, NULL, NULL },
+				{ "insert_remove_churn", bench_insert_remove_churn, NULL, NULL },
+				{ "dump", bench_dump, NULL, NULL },
+				{ "from_file", bench_from_file, NULL, NULL },
+		};
+
+static const unsigned long WORKLOAD_COUNT = sizeof workloads / sizeof *workloads;
+
+BenchResult_t run_in_this_process(const Workload_t* const workload, const BenchConfig_t* const config, const Dataset_t* const data)
+{
+	struct rusage usage;
+	BenchResult_t result = workload->run(workload, config, data);
+
+	getrusage(RUSAGE_SELF, &usage);
+	result.peak_rss_kb = usage.ru_maxrss;
+	return result;
+}
+
+// ru_maxrss only ever grows within a process, so each workload runs in a child of its own and reports its own peak
+// Children start from the same random state and share the dataset's pages, which count toward every peak alike
+BenchResult_t run_in_child(const Workload_t* const workload, const BenchConfig_t* const config, const Dataset_t* const data)
+{
+	int channel[2];
+
+	if (pipe(channel) != 0)
+		return run_in_this_process(workload, config, data);
+
+	fflush(stdout);
+	const pid_t child = fork();
+
+	if (child < 0)
+	{
+		close(channel[0]);
+		close(channel[1]);
+		return run_in_this_process(workload, config, data);
+	}
+
+	if (child == 0)
+	{
+		close(channel[0]);
+		const BenchResult_t result = workload->run(workload, config, data);
+		const bool sent = write(channel[1], &result, sizeof result) == (ssize_t)sizeof result;
+		_exit(sent ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	BenchResult_t result;
+	struct rusage usage;
+
+	close(channel[1]);
+	const bool received = read(channel[0], &result, sizeof result) == (ssize_t)sizeof result;
+	close(channel[0]);
+
+	if (wait4(child, NULL, 0, &usage) != child || !received)
+	{
+		fprintf(stderr, "Workload %s did not finish\n", workload->name);
+		exit(EXIT_FAILURE);
+	}
+
+	result.peak_rss_kb = usage.ru_maxrss;
+	return result;
+}
+
+void print_csv_header(FILE* out)
+{
+	fprintf(out, "workload,items,operations,total_ns,ns_per_op,ops_per_sec,capacity,peak_rss_kb\n");
+}
+
+void print_csv_row(const BenchResult_t* const r, FILE* out)
+{
+	fprintf(out, "%s,%lu,%lu,%.0f,%.2f,%.0f,%lu,%ld\n",
+			r->workload, r->items, r->operations, r->total_ns,
+			r->total_ns / r->operations, r->operations / (r->total_ns / 1e9),
+			r->capacity, r->peak_rss_kb);
+}
+
+void print_json_row(const BenchResult_t* const r, const bool last, FILE* out)
+{
+	fprintf(out,
+			"  {\"workload\": \"%s\", \"items\": %lu, \"operations\": %lu, \"total_ns\": %.0f, "
+			"\"ns_per_op\": %.2f, \"ops_per_sec\": %.0f, \"capacity\": %lu, \"peak_rss_kb\": %ld}%s\n",
+			r->workload, r->items, r->operations, r->total_ns,
+			r->total_ns / r->operations, r->operations / (r->total_ns / 1e9),
+			r->capacity, r->peak_rss_kb, last ? "" : ",");
+}
+
+BenchConfig_t parse_arguments(const int argc, char** const argv)
+{
+	BenchConfig_t config = { DEFAULT_ITEM_COUNT, DEFAULT_OPERATION_COUNT, false };
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--json") == 0)
+			config.json = true;
+		else if (strcmp(argv[i], "--items") == 0 && i + 1 < argc)
+			config.items = strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc)
+			config.operations = strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "Usage: %s [--items N] [--ops N] [--json]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (config.items < 2 || config.operations < 2)
+	{
+		fprintf(stderr, "--items and --ops must be at least 2\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return config;
+}
+
+int main(const int argc, char** const argv)
+{
+	const BenchConfig_t config = parse_arguments(argc, argv);
+	Dataset_t data = make_dataset(config.items);
+
+	if (config.json)
+		printf("[\n");
+	else
+		print_csv_header(stdout);
+
+	for (unsigned long w = 0; w < WORKLOAD_COUNT; ++w)
+	{
+		const BenchResult_t result = run_in_child(&workloads[w], &config, &data);
+
+		if (config.json)
+			print_json_row(&result, w + 1 == WORKLOAD_COUNT, stdout);
+		else
+			print_csv_row(&result, stdout);
+	}
+
+	if (config.json)
+		printf("]\n");
+
+	delete_dataset(&data);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdalign.h>
+
+#include "article.h"
+#include "cuckoo_table.h"
+#include "ht_capacity.h"
+#include "key_hash.h"
+
+#define CT_SLOTS_PER_BUCKET 4
+#define CT_CACHE_LINE_SIZE 64
+
+static const unsigned CT_MAX_DISPLACEMENTS = 500;
+static const double CT_HIGH_DENSITY_BOUND = 0.9;
+static const double CT_LOW_DENSITY_BOUND = 0.2;
+static const unsigned long long CT_HASH_SEED = 0;
+static const unsigned long long CT_ALTERNATE_BUCKET_SALT = 0xC2B2AE3D27D4EB4Fllu;
+static const uint8_t CT_EMPTY_TAG = 0;
+
+// Tags filter out almost every slot whose key would not match, without touching its article
+typedef struct Bucket_s
+{
+	alignas(CT_CACHE_LINE_SIZE) uint8_t tags[CT_SLOTS_PER_BUCKET];
+	Article_t* items[CT_SLOTS_PER_BUCKET];
+} Bucket_t;
+
+typedef struct KeyPlacement_s
+{
+	unsigned long first_bucket;
+	unsigned long second_bucket;
+	uint8_t tag;
+} KeyPlacement_t;
+
+struct CuckooTable_s
+{
+	unsigned long count;
+	unsigned long bucket_count;
+	unsigned short capacity_index;
+	unsigned long long random_state;
+	Bucket_t* buckets;
+};
+
+Bucket_t* alloc_buckets(const unsigned long bucket_count)
+{
+	Bucket_t* const buckets = (Bucket_t*)aligned_alloc(CT_CACHE_LINE_SIZE, bucket_count * sizeof(Bucket_t));
+	memset(buckets, 0, bucket_count * sizeof(Bucket_t));
+	return buckets;
+}
+
+CuckooTable_t* ct_new(void)
+{
+	CuckooTable_t* const ct = (CuckooTable_t*)malloc(sizeof(CuckooTable_t));
+
+	ct->count = 0;
+	ct->capacity_index = 0;
+	ct->bucket_count = calculate_optimal_capacity_for_index(0);
+	ct->random_state = 0x9E3779B97F4A7C15llu;
+	ct->buckets = alloc_buckets(ct->bucket_count);
+
+	return ct;
+}
+
+void ct_delete(CuckooTable_t* const ct)
+{
+	for (unsigned long b = 0; b < ct->bucket_count; ++b)
+		for (int s = 0; s < CT_SLOTS_PER_BUCKET; ++s)
+			if (ct->buckets[b].tags[s] != CT_EMPTY_TAG)
+				delete_article(ct->buckets[b].items[s]);
+
+	free(ct->buckets);
+	free(ct);
+}
+
+unsigned long ct_count(const CuckooTable_t* const ct)
+{
+	return ct->count;
+}
+
+unsigned long ct_capacity(const CuckooTable_t* const ct)
+{
+	return ct->bucket_count * CT_SLOTS_PER_BUCKET;
+}
+
+KeyPlacement_t placement_of_key(const unsigned long bucket_count, const char* const key, const unsigned long len)
+{
+	// Only the bytes an article can store take part, so long keys land where their truncated copies do
+	const unsigned long long hash = kh_hash_bytes(key, stored_key_length(len), CT_HASH_SEED);
+	const unsigned long first = hash % bucket_count;
+	unsigned long second = kh_mix(hash ^ CT_ALTERNATE_BUCKET_SALT) % bucket_count;
+
+	// Two distinct buckets keep every key movable
+	if (second == first && bucket_count > 1)
+		second = (first + 1) % bucket_count;
+
+	const KeyPlacement_t placement = { first, second, (uint8_t)((hash >> 56) | 1) };
+	return placement;
+}
+
+unsigned long next_random_below(CuckooTable_t* const ct, const unsigned long bound)
+{
+	ct->random_state ^= ct->random_state >> 12;
+	ct->random_state ^= ct->random_state << 25;
+	ct->random_state ^= ct->random_state >> 27;
+	return (ct->random_state * 0x2545F4914F6CDD1Dllu >> 32) % bound;
+}
+
+Article_t** find_slot_of_key(const Bucket_t* const buckets, const KeyPlacement_t placement, const char* const key)
+{
+	const unsigned long candidates[] = { placement.first_bucket, placement.second_bucket };
+
+	for (int c = 0; c < 2; ++c)
+	{
+		Bucket_t* const bucket = (Bucket_t*)&buckets[candidates[c]];
+
+		for (int s = 0; s < CT_SLOTS_PER_BUCKET; ++s)
+			if (bucket->tags[s] == placement.tag && article_has_key(bucket->items[s], key))
+				return &bucket->items[s];
+	}
+
+	return NULL;
+}
+
+bool ct_contains(const CuckooTable_t* const ct, const char* const key)
+{
+	return ct_fetch(ct, key) != NULL;
+}
+
+const Article_t* ct_fetch(const CuckooTable_t* const ct, const char* const key)
+{
+	Article_t** const slot = find_slot_of_key(ct->buckets, placement_of_key(ct->bucket_count, key, strlen(key)), key);
+	return slot != NULL ? *slot : NULL;
+}
+
+bool place_in_free_slot(Bucket_t* const bucket, Article_t* const item, const uint8_t tag)
+{
+	for (int s = 0; s < CT_SLOTS_PER_BUCKET; ++s)
+	{
+		if (bucket->tags[s] == CT_EMPTY_TAG)
+		{
+			bucket->tags[s] = tag;
+			bucket->items[s] = item;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Places an owned article whose key is absent; returns the article left homeless after too many kicks, or NULL
+Article_t* place_item(CuckooTable_t* const ct, Bucket_t* const buckets, const unsigned long bucket_count, Article_t* item)
+{
+	KeyPlacement_t placement = placement_of_key(bucket_count, key_of(item), key_length_of(item));
+	unsigned long bucket = placement.first_bucket;
+
+	if (place_in_free_slot(&buckets[placement.first_bucket], item, placement.tag)
+		|| place_in_free_slot(&buckets[placement.second_bucket], item, placement.tag))
+		return NULL;
+
+	// Random walk: evict a random resident, then send it to its other bucket
+	for (unsigned kick = 0; kick < CT_MAX_DISPLACEMENTS; ++kick)
+	{
+		const unsigned long s = next_random_below(ct, CT_SLOTS_PER_BUCKET);
+		Article_t* const evicted = buckets[bucket].items[s];
+
+		buckets[bucket].items[s] = item;
+		buckets[bucket].tags[s] = placement.tag;
+
+		item = evicted;
+		placement = placement_of_key(bucket_count, key_of(item), key_length_of(item));
+		bucket = placement.first_bucket == bucket ? placement.second_bucket : placement.first_bucket;
+
+		if (place_in_free_slot(&buckets[bucket], item, placement.tag))
+			return NULL;
+	}
+
+	return item;
+}
+
+bool rebuild_into(CuckooTable_t* const ct, const unsigned long bucket_count)
+{
+	Bucket_t* const buckets = alloc_buckets(bucket_count);
+
+	for (unsigned long b = 0; b < ct->bucket_count; ++b)
+	{
+		for (int s = 0; s < CT_SLOTS_PER_BUCKET; ++s)
+		{
+			// Every article is still owned by the old buckets, so a failed rebuild loses nothing
+			if (ct->buckets[b].tags[s] != CT_EMPTY_TAG
+				&& place_item(ct, buckets, bucket_count, ct->buckets[b].items[s]) != NULL)
+			{
+				free(buckets);
+				return false;
+			}
+		}
+	}
+
+	free(ct->buckets);
+	ct->buckets = buckets;
+	ct->bucket_count = bucket_count;
+	return true;
+}
+
+void resize_to_index(CuckooTable_t* const ct, unsigned short index)
+{
+	while (!rebuild_into(ct, calculate_optimal_capacity_for_index(index)) && index < maximum_capacity_index())
+		index++;
+
+	ct->capacity_index = index;
+}
+
+double ct_density(const CuckooTable_t* const ct)
+{
+	return (double)ct->count / ct_capacity(ct);
+}
+
+void ct_insert(CuckooTable_t* const ct, const Article_t* const article)
+{
+	const KeyPlacement_t placement = placement_of_key(ct->bucket_count, key_of(article), key_length_of(article));
+	Article_t** const slot = find_slot_of_key(ct->buckets, placement, key_of(article));
+
+	if (slot != NULL)
+	{
+		delete_article(*slot);
+		*slot = duplicate_article(article);
+		return;
+	}
+
+	if ((double)(ct->count + 1) / ct_capacity(ct) > CT_HIGH_DENSITY_BOUND)
+		resize_to_index(ct, ct->capacity_index + 1);
+
+	Article_t* homeless = place_item(ct, ct->buckets, ct->bucket_count, duplicate_article(article));
+
+	while (homeless != NULL)
+	{
+		resize_to_index(ct, ct->capacity_index + 1);
+		homeless = place_item(ct, ct->buckets, ct->bucket_count, homeless);
+	}
+
+	ct->count++;
+}
+
+void ct_remove(CuckooTable_t* const ct, const char* const key)
+{
+	const KeyPlacement_t placement = placement_of_key(ct->bucket_count, key, strlen(key));
+	Article_t** const slot = find_slot_of_key(ct->buckets, placement, key);
+
+	if (slot == NULL)
+		return;
+
+	// Slot and tag share a bucket: recover the tag from the slot's position
+	Bucket_t* const bucket = &ct->buckets[((unsigned char*)slot - (unsigned char*)ct->buckets) / sizeof(Bucket_t)];
+	bucket->tags[slot - bucket->items] = CT_EMPTY_TAG;
+	delete_article(*slot);
+	ct->count--;
+
+	if (ct_density(ct) < CT_LOW_DENSITY_BOUND && ct->capacity_index != 0)
+		resize_to_index(ct, ct->capacity_index - 1);
+}
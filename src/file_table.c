@@ -0,0 +1,460 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "article.h"
+#include "file_table.h"
+#include "key_hash.h"
+
+#define FT_PAGE_SIZE 4096lu
+#define FT_MAGIC "HTFILE1"
+
+static const unsigned long FT_INITIAL_BUCKETS = 4;
+static const double FT_SPLIT_DENSITY = 0.75;
+static const unsigned long long FT_HASH_SEED = 0;
+static const uint64_t FT_NO_PAGE = 0;
+
+typedef struct FileHeader_s
+{
+	char magic[8];
+	uint32_t page_size;
+	uint32_t record_size;
+	uint64_t level;
+	uint64_t split;
+	uint64_t count;
+	uint64_t overflow_pages;
+	uint64_t free_overflow_page;
+} FileHeader_t;
+
+typedef struct PageHeader_s
+{
+	uint32_t record_count;
+	uint32_t unused;
+	uint64_t next_overflow_page;
+} PageHeader_t;
+
+typedef struct MappedFile_s
+{
+	int fd;
+	unsigned char* base;
+	unsigned long mapped_pages;
+} MappedFile_t;
+
+struct FileTable_s
+{
+	MappedFile_t buckets; // Page 0 is the header, bucket i lives in page i + 1
+	MappedFile_t overflow; // Page 0 is never used, so 0 can mean "no page"
+	unsigned long records_per_page;
+};
+
+void forget_mapped_file(MappedFile_t* const file)
+{
+	file->fd = -1;
+	file->base = NULL;
+	file->mapped_pages = 0;
+}
+
+bool open_mapped_file(MappedFile_t* const file, const char* const path)
+{
+	forget_mapped_file(file);
+	file->fd = open(path, O_RDWR | O_CREAT, 0644);
+	return file->fd >= 0;
+}
+
+void close_mapped_file(MappedFile_t* const file)
+{
+	if (file->base != NULL)
+		munmap(file->base, file->mapped_pages * FT_PAGE_SIZE);
+	if (file->fd >= 0)
+		close(file->fd);
+}
+
+unsigned long bytes_in_file(const MappedFile_t* const file)
+{
+	struct stat st;
+	return fstat(file->fd, &st) == 0 ? (unsigned long)st.st_size : 0;
+}
+
+unsigned long pages_in_file(const MappedFile_t* const file)
+{
+	return bytes_in_file(file) / FT_PAGE_SIZE;
+}
+
+// On failure the previous mapping stays in place
+bool map_pages(MappedFile_t* const file, const unsigned long pages)
+{
+	void* const base = mmap(NULL, pages * FT_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+
+	if (base == MAP_FAILED)
+		return false;
+
+	if (file->base != NULL)
+		munmap(file->base, file->mapped_pages * FT_PAGE_SIZE);
+
+	file->base = (unsigned char*)base;
+	file->mapped_pages = pages;
+	return true;
+}
+
+// False if the file could not grow; its mapping is then unchanged
+bool ensure_pages(MappedFile_t* const file, const unsigned long pages)
+{
+	if (pages <= file->mapped_pages)
+		return true;
+
+	// Doubling keeps remaps rare; the extension is sparse until a page is written
+	unsigned long target = file->mapped_pages > 0 ? file->mapped_pages : 1;
+	while (target < pages)
+		target *= 2;
+
+	return ftruncate(file->fd, (off_t)(target * FT_PAGE_SIZE)) == 0 && map_pages(file, target);
+}
+
+void* page_of(const MappedFile_t* const file, const uint64_t page)
+{
+	return file->base + page * FT_PAGE_SIZE;
+}
+
+FileHeader_t* header_of(const FileTable_t* const ft)
+{
+	return (FileHeader_t*)page_of(&ft->buckets, 0);
+}
+
+unsigned long ft_bucket_count(const FileTable_t* const ft)
+{
+	const FileHeader_t* const header = header_of(ft);
+	return (FT_INITIAL_BUCKETS << header->level) + header->split;
+}
+
+unsigned long ft_count(const FileTable_t* const ft)
+{
+	return header_of(ft)->count;
+}
+
+PageHeader_t* bucket_page(const FileTable_t* const ft, const unsigned long bucket)
+{
+	return (PageHeader_t*)page_of(&ft->buckets, bucket + 1);
+}
+
+PageHeader_t* overflow_page(const FileTable_t* const ft, const uint64_t page)
+{
+	return (PageHeader_t*)page_of(&ft->overflow, page);
+}
+
+PageHeader_t* next_page_in_chain(const FileTable_t* const ft, const PageHeader_t* const page)
+{
+	return page->next_overflow_page != FT_NO_PAGE ? overflow_page(ft, page->next_overflow_page) : NULL;
+}
+
+unsigned char* record_in_page(const FileTable_t* const ft, PageHeader_t* const page, const unsigned long i)
+{
+	(void)ft;
+	return (unsigned char*)(page + 1) + i * article_footprint();
+}
+
+unsigned long bucket_of_hash(const FileTable_t* const ft, const unsigned long long hash)
+{
+	const FileHeader_t* const header = header_of(ft);
+	const unsigned long bucket = hash % (FT_INITIAL_BUCKETS << header->level);
+
+	// Buckets before the split pointer have already been split with the next level's modulus
+	return bucket < header->split ? hash % (FT_INITIAL_BUCKETS << (header->level + 1)) : bucket;
+}
+
+unsigned long bucket_of_key(const FileTable_t* const ft, const char* const key, const unsigned long len)
+{
+	// Only the bytes a record can store take part, so long keys land where their truncated copies do
+	return bucket_of_hash(ft, kh_hash_bytes(key, stored_key_length(len), FT_HASH_SEED));
+}
+
+bool initialize_new_file(FileTable_t* const ft)
+{
+	if (!ensure_pages(&ft->buckets, FT_INITIAL_BUCKETS + 1) || !ensure_pages(&ft->overflow, 1))
+		return false;
+
+	FileHeader_t* const header = header_of(ft);
+	memset(header, 0, sizeof(FileHeader_t));
+	memcpy(header->magic, FT_MAGIC, sizeof FT_MAGIC);
+	header->page_size = FT_PAGE_SIZE;
+	header->record_size = article_footprint();
+	return true;
+}
+
+bool header_is_compatible(const FileTable_t* const ft)
+{
+	const FileHeader_t* const header = header_of(ft);
+	return memcmp(header->magic, FT_MAGIC, sizeof FT_MAGIC) == 0
+		   && header->page_size == FT_PAGE_SIZE
+		   && header->record_size == article_footprint();
+}
+
+// Every page the header refers to has to be in the files, or following a chain would run off the mapping
+bool files_hold_every_page(const FileTable_t* const ft)
+{
+	const FileHeader_t* const header = header_of(ft);
+	return ft->buckets.mapped_pages >= ft_bucket_count(ft) + 1
+		   && pages_in_file(&ft->overflow) >= header->overflow_pages + 1;
+}
+
+char* overflow_path_of(const char* const path)
+{
+	static const char suffix[] = ".ovf";
+	char* const overflow_path = (char*)malloc(strlen(path) + sizeof suffix);
+	strcpy(overflow_path, path);
+	strcat(overflow_path, suffix);
+	return overflow_path;
+}
+
+FileTable_t* ft_open(const char* const path)
+{
+	FileTable_t* const ft = (FileTable_t*)malloc(sizeof(FileTable_t));
+	char* const overflow_path = overflow_path_of(path);
+
+	forget_mapped_file(&ft->overflow);
+	const bool opened = open_mapped_file(&ft->buckets, path) && open_mapped_file(&ft->overflow, overflow_path);
+
+	free(overflow_path);
+	ft->records_per_page = (FT_PAGE_SIZE - sizeof(PageHeader_t)) / article_footprint();
+
+	// ft_close copes with whatever part of the table got opened or mapped
+	if (!opened)
+	{
+		ft_close(ft);
+		return NULL;
+	}
+
+	if (bytes_in_file(&ft->buckets) == 0)
+	{
+		if (initialize_new_file(ft))
+			return ft;
+
+		ft_close(ft);
+		return NULL;
+	}
+
+	const bool valid = pages_in_file(&ft->buckets) > 0
+					   && map_pages(&ft->buckets, pages_in_file(&ft->buckets))
+					   && header_is_compatible(ft)
+					   && files_hold_every_page(ft)
+					   && map_pages(&ft->overflow, pages_in_file(&ft->overflow));
+
+	if (!valid)
+	{
+		ft_close(ft);
+		return NULL;
+	}
+
+	return ft;
+}
+
+void ft_sync(FileTable_t* const ft)
+{
+	msync(ft->buckets.base, ft->buckets.mapped_pages * FT_PAGE_SIZE, MS_SYNC);
+	msync(ft->overflow.base, ft->overflow.mapped_pages * FT_PAGE_SIZE, MS_SYNC);
+}
+
+void ft_close(FileTable_t* const ft)
+{
+	close_mapped_file(&ft->buckets);
+	close_mapped_file(&ft->overflow);
+	free(ft);
+}
+
+unsigned char* find_record_of_key(
+		const FileTable_t* const ft, const char* const key, const unsigned long len, PageHeader_t** const page_out)
+{
+	const unsigned long bucket = bucket_of_key(ft, key, len);
+
+	for (PageHeader_t* page = bucket_page(ft, bucket); page != NULL; page = next_page_in_chain(ft, page))
+	{
+		for (unsigned long i = 0; i < page->record_count; ++i)
+		{
+			unsigned char* const record = record_in_page(ft, page, i);
+
+			if (article_has_key(article_view_of_record(record), key))
+			{
+				if (page_out != NULL)
+					*page_out = page;
+				return record;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+bool ft_contains(const FileTable_t* const ft, const char* const key)
+{
+	return find_record_of_key(ft, key, strlen(key), NULL) != NULL;
+}
+
+const Article_t* ft_fetch(const FileTable_t* const ft, const char* const key)
+{
+	const unsigned char* const record = find_record_of_key(ft, key, strlen(key), NULL);
+	return record != NULL ? article_view_of_record(record) : NULL;
+}
+
+// FT_NO_PAGE if the overflow file could not grow
+uint64_t allocate_overflow_page(FileTable_t* const ft)
+{
+	FileHeader_t* header = header_of(ft);
+	uint64_t page = header->free_overflow_page;
+
+	if (page != FT_NO_PAGE)
+	{
+		header->free_overflow_page = overflow_page(ft, page)->next_overflow_page;
+	}
+	else
+	{
+		if (!ensure_pages(&ft->overflow, header->overflow_pages + 2))
+			return FT_NO_PAGE;
+
+		page = ++header->overflow_pages;
+	}
+
+	PageHeader_t* const fresh = overflow_page(ft, page);
+	fresh->record_count = 0;
+	fresh->next_overflow_page = FT_NO_PAGE;
+
+	return page;
+}
+
+// May grow the overflow file, which moves its mapping: callers must not hold overflow page pointers across it
+// NULL, with the bucket unchanged, if the overflow file could not grow
+unsigned char* append_record_to_bucket(FileTable_t* const ft, const unsigned long bucket)
+{
+	PageHeader_t* page = bucket_page(ft, bucket);
+
+	while (page->record_count == ft->records_per_page)
+	{
+		if (page->next_overflow_page == FT_NO_PAGE)
+		{
+			// Bucket pages live in the other file, so only overflow pages need relocating after the remap
+			const bool is_bucket_page = page == bucket_page(ft, bucket);
+			const uint64_t previous = is_bucket_page ? FT_NO_PAGE
+													 : (uint64_t)(((unsigned char*)page - ft->overflow.base) / FT_PAGE_SIZE);
+			const uint64_t fresh = allocate_overflow_page(ft);
+
+			if (fresh == FT_NO_PAGE)
+				return NULL;
+
+			page = is_bucket_page ? bucket_page(ft, bucket) : overflow_page(ft, previous);
+			page->next_overflow_page = fresh;
+		}
+
+		page = next_page_in_chain(ft, page);
+	}
+
+	return record_in_page(ft, page, page->record_count++);
+}
+
+void split_next_bucket(FileTable_t* const ft)
+{
+	FileHeader_t* header = header_of(ft);
+	const unsigned long old_bucket = header->split;
+	const unsigned long new_bucket = (FT_INITIAL_BUCKETS << header->level) + header->split;
+	const unsigned long record_size = article_footprint();
+
+	// Without room for the new bucket the table just stays denser; the next insert tries again
+	if (!ensure_pages(&ft->buckets, new_bucket + 2))
+		return;
+
+	header = header_of(ft);
+
+	// Lift every record of the old chain out, release its overflow pages, then deal records to both buckets
+	unsigned long held = 0, room = ft->records_per_page;
+	unsigned char* records = (unsigned char*)malloc(room * record_size);
+	PageHeader_t* page = bucket_page(ft, old_bucket);
+
+	while (page != NULL)
+	{
+		if (held + page->record_count > room)
+		{
+			room = 2 * (held + page->record_count);
+			records = (unsigned char*)realloc(records, room * record_size);
+		}
+
+		memcpy(records + held * record_size, record_in_page(ft, page, 0), page->record_count * record_size);
+		held += page->record_count;
+
+		PageHeader_t* const next = next_page_in_chain(ft, page);
+		if (page != bucket_page(ft, old_bucket))
+		{
+			const uint64_t page_number = ((unsigned char*)page - ft->overflow.base) / FT_PAGE_SIZE;
+			page->next_overflow_page = header->free_overflow_page;
+			header->free_overflow_page = page_number;
+		}
+		page = next;
+	}
+
+	bucket_page(ft, old_bucket)->record_count = 0;
+	bucket_page(ft, old_bucket)->next_overflow_page = FT_NO_PAGE;
+	bucket_page(ft, new_bucket)->record_count = 0;
+	bucket_page(ft, new_bucket)->next_overflow_page = FT_NO_PAGE;
+
+	if (++header->split == FT_INITIAL_BUCKETS << header->level)
+	{
+		header->level++;
+		header->split = 0;
+	}
+
+	// The pages released above are enough for both chains, so these appends never grow the file
+	for (unsigned long i = 0; i < held; ++i)
+	{
+		const unsigned char* const record = records + i * record_size;
+		const Article_t* const stored = article_view_of_record(record);
+		memcpy(append_record_to_bucket(ft, bucket_of_key(ft, key_of(stored), key_length_of(stored))), record, record_size);
+	}
+
+	free(records);
+}
+
+double ft_density(const FileTable_t* const ft)
+{
+	return (double)ft_count(ft) / (ft_bucket_count(ft) * ft->records_per_page);
+}
+
+bool ft_insert(FileTable_t* const ft, const Article_t* const article)
+{
+	unsigned char* const existing = find_record_of_key(ft, key_of(article), key_length_of(article), NULL);
+
+	if (existing != NULL)
+	{
+		article_to_record(article, existing);
+		return true;
+	}
+
+	unsigned char* const record = append_record_to_bucket(ft, bucket_of_key(ft, key_of(article), key_length_of(article)));
+
+	if (record == NULL)
+		return false;
+
+	article_to_record(article, record);
+	header_of(ft)->count++;
+
+	if (ft_density(ft) > FT_SPLIT_DENSITY)
+		split_next_bucket(ft);
+
+	return true;
+}
+
+void ft_remove(FileTable_t* const ft, const char* const key)
+{
+	PageHeader_t* page;
+	unsigned char* const record = find_record_of_key(ft, key, strlen(key), &page);
+
+	if (record == NULL)
+		return;
+
+	// Keep pages packed: the page's last record fills the hole
+	unsigned char* const last = record_in_page(ft, page, --page->record_count);
+	if (last != record)
+		memcpy(record, last, article_footprint());
+
+	header_of(ft)->count--;
+}
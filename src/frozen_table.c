@@ -0,0 +1,292 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "article.h"
+#include "frozen_table.h"
+#include "key_hash.h"
+
+#define FZ_MAGIC "HTFROZ1"
+
+static const unsigned long FZ_KEYS_PER_BUCKET = 4;
+static const uint32_t FZ_MAX_DISPLACEMENT = 1u << 24;
+static const unsigned long long FZ_DISPLACEMENT_MULTIPLIER = 0x9E3779B97F4A7C15llu;
+
+typedef struct FrozenHeader_s
+{
+	char magic[8];
+	uint64_t count;
+	uint64_t bucket_count;
+	uint64_t seed;
+	uint64_t record_size;
+} FrozenHeader_t;
+
+struct FrozenTable_s
+{
+	unsigned char* image; // Header, then displacements, then records, each 8-byte aligned
+	unsigned long image_size;
+	bool mapped;
+	const FrozenHeader_t* header;
+	const uint32_t* displacements;
+	const unsigned char* records;
+};
+
+typedef struct KeyedArticle_s
+{
+	unsigned long long hash;
+	unsigned long bucket;
+	const Article_t* article;
+} KeyedArticle_t;
+
+unsigned long round_up_to_8(const unsigned long size)
+{
+	return (size + 7) / 8 * 8;
+}
+
+unsigned long image_size_for(const unsigned long count, const unsigned long bucket_count)
+{
+	return sizeof(FrozenHeader_t)
+		   + round_up_to_8(bucket_count * sizeof(uint32_t))
+		   + count * article_footprint();
+}
+
+void point_into_image(FrozenTable_t* const fz)
+{
+	fz->header = (const FrozenHeader_t*)fz->image;
+	fz->displacements = (const uint32_t*)(fz->image + sizeof(FrozenHeader_t));
+	fz->records = fz->image + sizeof(FrozenHeader_t) + round_up_to_8(fz->header->bucket_count * sizeof(uint32_t));
+}
+
+unsigned long long hash_of_key(const char* const key, const unsigned long len, const unsigned long long seed)
+{
+	// Only the bytes an article can store take part, so long keys land where their truncated copies do
+	return kh_hash_bytes(key, stored_key_length(len), seed);
+}
+
+unsigned long bucket_of(const unsigned long long hash, const unsigned long bucket_count)
+{
+	return hash % bucket_count;
+}
+
+unsigned long position_of(const unsigned long long hash, const uint32_t displacement, const unsigned long count)
+{
+	return kh_mix(hash ^ (displacement * FZ_DISPLACEMENT_MULTIPLIER)) % count;
+}
+
+int compare_by_bucket(const void* const a, const void* const b)
+{
+	const KeyedArticle_t* const x = (const KeyedArticle_t*)a;
+	const KeyedArticle_t* const y = (const KeyedArticle_t*)b;
+	return (x->bucket > y->bucket) - (x->bucket < y->bucket);
+}
+
+typedef struct BucketRange_s
+{
+	unsigned long first;
+	unsigned long size;
+} BucketRange_t;
+
+int compare_by_size_descending(const void* const a, const void* const b)
+{
+	const BucketRange_t* const x = (const BucketRange_t*)a;
+	const BucketRange_t* const y = (const BucketRange_t*)b;
+	return (x->size < y->size) - (x->size > y->size);
+}
+
+bool bucket_fits(
+		const KeyedArticle_t* const keys, const BucketRange_t range, const uint32_t displacement,
+		const unsigned long count, const bool* const taken, unsigned long* const positions)
+{
+	for (unsigned long k = 0; k < range.size; ++k)
+	{
+		positions[k] = position_of(keys[range.first + k].hash, displacement, count);
+
+		if (taken[positions[k]])
+			return false;
+
+		for (unsigned long j = 0; j < k; ++j)
+			if (positions[j] == positions[k])
+				return false;
+	}
+
+	return true;
+}
+
+// Places the biggest buckets first, while most positions are still free
+bool find_displacements(
+		KeyedArticle_t* const keys, const unsigned long count, const unsigned long bucket_count,
+		uint32_t* const displacements, unsigned long* const slot_of_key)
+{
+	BucketRange_t* const ranges = (BucketRange_t*)calloc(bucket_count, sizeof(BucketRange_t));
+	bool* const taken = (bool*)calloc(count, sizeof(bool));
+	unsigned long* const positions = (unsigned long*)malloc(count * sizeof(unsigned long));
+	bool success = true;
+
+	qsort(keys, count, sizeof(KeyedArticle_t), compare_by_bucket);
+	for (unsigned long k = 0; k < count; ++k)
+	{
+		if (ranges[keys[k].bucket].size++ == 0)
+			ranges[keys[k].bucket].first = k;
+	}
+	qsort(ranges, bucket_count, sizeof(BucketRange_t), compare_by_size_descending);
+
+	for (unsigned long b = 0; success && b < bucket_count && ranges[b].size > 0; ++b)
+	{
+		const BucketRange_t range = ranges[b];
+		uint32_t displacement = 0;
+
+		while (displacement < FZ_MAX_DISPLACEMENT && !bucket_fits(keys, range, displacement, count, taken, positions))
+			displacement++;
+
+		if (displacement == FZ_MAX_DISPLACEMENT)
+		{
+			success = false;
+			break;
+		}
+
+		displacements[keys[range.first].bucket] = displacement;
+		for (unsigned long k = 0; k < range.size; ++k)
+		{
+			taken[positions[k]] = true;
+			slot_of_key[range.first + k] = positions[k];
+		}
+	}
+
+	free(ranges);
+	free(taken);
+	free(positions);
+	return success;
+}
+
+FrozenTable_t* fz_build(const Article_t* const* const articles, const unsigned long count)
+{
+	FrozenTable_t* const fz = (FrozenTable_t*)malloc(sizeof(FrozenTable_t));
+	const unsigned long bucket_count = count / FZ_KEYS_PER_BUCKET + 1;
+	KeyedArticle_t* const keys = (KeyedArticle_t*)malloc((count + 1) * sizeof(KeyedArticle_t));
+	unsigned long* const slot_of_key = (unsigned long*)malloc((count + 1) * sizeof(unsigned long));
+
+	fz->image_size = image_size_for(count, bucket_count);
+	fz->image = (unsigned char*)calloc(fz->image_size, 1);
+	fz->mapped = false;
+
+	FrozenHeader_t* const header = (FrozenHeader_t*)fz->image;
+	memcpy(header->magic, FZ_MAGIC, sizeof FZ_MAGIC);
+	header->count = count;
+	header->bucket_count = bucket_count;
+	header->record_size = article_footprint();
+	point_into_image(fz);
+
+	uint32_t* const displacements = (uint32_t*)fz->displacements;
+
+	// A seed that leaves some bucket unplaceable is rare; another seed reshuffles every bucket
+	for (header->seed = 0;; header->seed++)
+	{
+		for (unsigned long k = 0; k < count; ++k)
+		{
+			keys[k].article = articles[k];
+			keys[k].hash = hash_of_key(key_of(articles[k]), key_length_of(articles[k]), header->seed);
+			keys[k].bucket = bucket_of(keys[k].hash, bucket_count);
+		}
+
+		memset(displacements, 0, bucket_count * sizeof(uint32_t));
+
+		if (find_displacements(keys, count, bucket_count, displacements, slot_of_key))
+			break;
+	}
+
+	for (unsigned long k = 0; k < count; ++k)
+		article_to_record(keys[k].article, (unsigned char*)fz->records + slot_of_key[k] * article_footprint());
+
+	free(keys);
+	free(slot_of_key);
+	return fz;
+}
+
+bool image_is_valid(const unsigned char* const image, const unsigned long size)
+{
+	if (size < sizeof(FrozenHeader_t))
+		return false;
+
+	const FrozenHeader_t* const header = (const FrozenHeader_t*)image;
+	return memcmp(header->magic, FZ_MAGIC, sizeof FZ_MAGIC) == 0
+		   && header->record_size == article_footprint()
+		   && image_size_for(header->count, header->bucket_count) == size;
+}
+
+FrozenTable_t* fz_map(const char* const path)
+{
+	const int fd = open(path, O_RDONLY);
+	struct stat st;
+
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	void* const image = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (image == MAP_FAILED)
+		return NULL;
+
+	if (!image_is_valid((const unsigned char*)image, (unsigned long)st.st_size))
+	{
+		munmap(image, (size_t)st.st_size);
+		return NULL;
+	}
+
+	FrozenTable_t* const fz = (FrozenTable_t*)malloc(sizeof(FrozenTable_t));
+	fz->image = (unsigned char*)image;
+	fz->image_size = (unsigned long)st.st_size;
+	fz->mapped = true;
+	point_into_image(fz);
+
+	return fz;
+}
+
+void fz_delete(FrozenTable_t* const fz)
+{
+	if (fz->mapped)
+		munmap(fz->image, fz->image_size);
+	else
+		free(fz->image);
+
+	free(fz);
+}
+
+unsigned long fz_count(const FrozenTable_t* const fz)
+{
+	return fz->header->count;
+}
+
+const Article_t* fz_fetch(const FrozenTable_t* const fz, const char* const key)
+{
+	if (fz->header->count == 0)
+		return NULL;
+
+	const unsigned long long hash = hash_of_key(key, strlen(key), fz->header->seed);
+	const uint32_t displacement = fz->displacements[bucket_of(hash, fz->header->bucket_count)];
+	const unsigned long slot = position_of(hash, displacement, fz->header->count);
+	const Article_t* const candidate = article_view_of_record(fz->records + slot * article_footprint());
+
+	return article_has_key(candidate, key) ? candidate : NULL;
+}
+
+bool fz_contains(const FrozenTable_t* const fz, const char* const key)
+{
+	return fz_fetch(fz, key) != NULL;
+}
+
+void fz_save(const FrozenTable_t* const fz, FILE* const out)
+{
+	fwrite(fz->image, 1, fz->image_size, out);
+}
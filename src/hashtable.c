@@ -1,19 +1,54 @@
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "article.h"
 #include "hashtable.h"
+#include "ht_capacity.h"
+#include "ht_stats.h"
+#include "key_hash.h"
+#include "membership_filter.h"
+#include "slot_memory.h"
 
 typedef unsigned long ht_index_t;
 typedef enum HashTableCellState CellState_t;
 
+typedef struct CacheState_s
+{
+	unsigned long item_limit;
+	unsigned long clock_hand;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+	ht_loader_t loader;
+	void* loader_context;
+} CacheState_t;
+
 struct HashTable_s
 {
 	ht_index_t count;
+	ht_index_t removed;
 	ht_index_t capacity;
 	unsigned short capacity_index;
 	Article_t** items;
 	CellState_t* states;
+	bool uses_huge_pages;
+	SlotMemory_t items_memory;
+	SlotMemory_t states_memory;
+	bool uses_filter;
+	MembershipFilter_t* filter;
+	CacheState_t* cache;
+	unsigned char* reference_bits;
+	bool seeded_hash;
+	KeyHashSeed_t seed;
+	ht_index_t inserts_since_reseed;
+	Article_t* arena; // Left by ht_compact; its articles are released by count, never freed one by one
+	ht_index_t arena_size;
+	ht_index_t arena_live;
+	unsigned long generation; // Bumped whenever keys move to other slots, which invalidates HtKeyHash_t
+	HT_STATS_FIELD
 };
 
 enum HashTableCellState
@@ -21,17 +56,6 @@ enum HashTableCellState
 	OPEN, OCCUPIED, REMOVED
 };
 
-// Deltas are such that 2 ^ (i + 4) - deltas[i] is a prime
-// Keeping capacity as a prime is good for hash function dispersion
-static const unsigned short capacity_deltas[] =
-		{
-				3, 1, 3, 1, 5, 3, 3,
-				9, 3, 1, 3, 19, 15, 1, 5, 1, 3,
-				9, 3, 15, 3, 39, 5, 39, 57, 3, 35,
-				1, 5, 9, 41, 31, 5, 25, 45, 7, 87,
-				21, 11, 57, 17, 55, 21, 115, 59, 81, 27
-		};
-
 static unsigned long const HASH_FUNCTION_A = 31415;
 static unsigned long const HASH_FUNCTION_B = 27183;
 
@@ -40,51 +64,163 @@ static const int HT_KEY_NOT_FOUND = -1;
 static const double HT_LOW_DENSITY_BOUND = 0.25;
 static const double HT_HIGH_DENSITY_BOUND = 0.75;
 
-static const unsigned long HT_MAXIMUM_CAPACITY_INDEX = sizeof capacity_deltas / sizeof *capacity_deltas;
+// Cache tables stay at most half full: evictions leave tombstones, and a quarter of the table
+// has to fill with them before a same-capacity rehash clears them, so eviction stays O(1) amortized
+static const double HT_CACHE_DENSITY_BOUND = 0.5;
 
-unsigned long calculate_optimal_capacity_for_index(unsigned short index)
-{
-	return (1lu << (index + 4)) - capacity_deltas[index];
-}
+static const unsigned long long HT_FILTER_SEED = 0;
+
+// Random keys at our density bounds keep probe chains to a few dozen cells even in huge tables
+// Chains longer than this many cells per bit of capacity are treated as an attack
+static const ht_index_t HT_PROBE_LIMIT_PER_CAPACITY_BIT = 16;
+
+// Below this many slots per thread, starting the thread costs more than the lookups it takes over
+static const ht_index_t HT_MIN_SLOTS_PER_LOOKUP_THREAD = 1lu << 14;
+static const long HT_MAX_LOOKUP_THREADS = 16;
+
+// Internal: when nonzero, every lookup pass uses exactly this many threads, whatever the machine or table size
+// Lets the tests exercise the threaded path on single-core machines
+unsigned long ht_forced_lookup_threads = 0;
 
 void alloc_and_init_items_and_states(HashTable_t* const ht)
 {
-	ht->items = (Article_t**)malloc(ht->capacity * sizeof(Article_t*));
-	ht->states = (CellState_t*)malloc(ht->capacity * sizeof(CellState_t));
-
-	for (ht_index_t i = 0; i < ht->capacity; ++i)
+	// Zeroed memory already reads as NULL items in OPEN cells, so nothing has to walk the arrays
+	ht->items_memory = sm_alloc_zeroed(ht->capacity * sizeof(Article_t*), ht->uses_huge_pages);
+	ht->states_memory = sm_alloc_zeroed(ht->capacity * sizeof(CellState_t), ht->uses_huge_pages);
+	ht->items = (Article_t**)ht->items_memory.base;
+	ht->states = (CellState_t*)ht->states_memory.base;
+	ht->generation++;
+	HT_STATS_ALLOCATIONS(ht, 2);
+
+	// Sized for the fullest the table gets before expanding; refilled as items are moved in
+	ht->filter = ht->uses_filter ? mf_new((unsigned long)(ht->capacity * HT_HIGH_DENSITY_BOUND) + 1) : NULL;
+
+	// CLOCK bits start cleared: after a resize every item has to earn its second chance again
+	if (ht->cache != NULL)
 	{
-		ht->items[i] = NULL;
-		ht->states[i] = OPEN;
+		ht->reference_bits = (unsigned char*)calloc(ht->capacity, sizeof(unsigned char));
+		ht->cache->clock_hand = 0;
 	}
+	else
+		ht->reference_bits = NULL;
 }
 
 HashTable_t* ht_new(void)
+{
+	static const HashTableOptions_t default_options = { false };
+	return ht_new_with_options(&default_options);
+}
+
+unsigned long cache_item_limit(const HashTableOptions_t* const options)
+{
+	unsigned long limit = options->max_items;
+	const unsigned long limit_by_bytes = options->max_bytes / article_footprint();
+
+	if (options->max_bytes != 0 && (limit == 0 || limit_by_bytes < limit))
+		limit = limit_by_bytes;
+
+	return limit > 0 ? limit : 1;
+}
+
+CacheState_t* make_cache_state(const HashTableOptions_t* const options)
+{
+	if (options->max_items == 0 && options->max_bytes == 0)
+		return NULL;
+
+	CacheState_t* const cache = (CacheState_t*)calloc(1, sizeof(CacheState_t));
+	cache->item_limit = cache_item_limit(options);
+	cache->loader = options->loader;
+	cache->loader_context = options->loader_context;
+	return cache;
+}
+
+unsigned short smallest_capacity_index_for(const ht_index_t count, const double density_bound)
+{
+	unsigned short index = 0;
+
+	while (index != maximum_capacity_index()
+		   && count > calculate_optimal_capacity_for_index(index) * density_bound)
+		index++;
+
+	return index;
+}
+
+unsigned short minimum_capacity_index(const HashTable_t* const ht)
+{
+	return ht->cache != NULL ? smallest_capacity_index_for(ht->cache->item_limit, HT_CACHE_DENSITY_BOUND) : 0;
+}
+
+HashTable_t* ht_new_with_options(const HashTableOptions_t* const options)
 {
 	HashTable_t* const new_table = (HashTable_t*)malloc(sizeof(HashTable_t));
 
+	new_table->uses_filter = options->membership_filter;
+	new_table->uses_huge_pages = options->huge_pages;
+	new_table->cache = make_cache_state(options);
+	new_table->seeded_hash = options->seeded_hash;
+	new_table->seed = options->seeded_hash ? kh_random_seed() : (KeyHashSeed_t){ 0, 0 };
+	new_table->inserts_since_reseed = 0;
+	new_table->arena = NULL;
+	new_table->arena_size = 0;
+	new_table->arena_live = 0;
+	new_table->generation = 0;
 	new_table->count = 0;
-	new_table->capacity_index = 0;
-	new_table->capacity = calculate_optimal_capacity_for_index(0);
+	new_table->removed = 0;
+	new_table->capacity_index = minimum_capacity_index(new_table);
+	new_table->capacity = calculate_optimal_capacity_for_index(new_table->capacity_index);
+	HT_STATS_INIT(new_table);
 
 	alloc_and_init_items_and_states(new_table);
 
 	return new_table;
 }
 
+bool item_is_in_arena(const HashTable_t* const ht, const Article_t* const item)
+{
+	return article_is_in_block(ht->arena, ht->arena_size, item);
+}
+
+void release_item(HashTable_t* const ht, Article_t* const item)
+{
+	if (!item_is_in_arena(ht, item))
+	{
+		delete_article(item);
+		return;
+	}
+
+	if (--ht->arena_live == 0)
+	{
+		delete_article_block(ht->arena);
+		ht->arena = NULL;
+		ht->arena_size = 0;
+	}
+}
+
+void free_items_and_states(HashTable_t* const ht)
+{
+	sm_free(ht->items_memory);
+	sm_free(ht->states_memory);
+
+	if (ht->filter != NULL)
+		mf_delete(ht->filter);
+
+	free(ht->reference_bits);
+}
+
 void delete_and_free_items_and_states(HashTable_t* const ht)
 {
 	for (ht_index_t i = 0; i < ht->capacity; ++i)
 		if (ht->states[i] == OCCUPIED)
-			delete_article(ht->items[i]);
+			release_item(ht, ht->items[i]);
 
-	free(ht->items);
-	free(ht->states);
+	free_items_and_states(ht);
 }
 
 void ht_delete(HashTable_t* const ht)
 {
 	delete_and_free_items_and_states(ht);
+	HT_STATS_FREE(ht);
+	free(ht->cache);
 	free(ht);
 }
 
@@ -93,13 +229,19 @@ bool ht_is_empty(const HashTable_t* const ht)
 	return ht->count == 0;
 }
 
-ht_index_t ht_hash_key(const HashTable_t* const ht, const char* key)
+ht_index_t ht_hash_key(const HashTable_t* const ht, const char* const key, const unsigned long len)
 {
+	// Only the bytes an article can store take part, so long keys land where their truncated copies do
+	const unsigned long hashed_len = stored_key_length(len);
+
+	if (ht->seeded_hash)
+		return kh_siphash_bytes(key, hashed_len, &ht->seed) % ht->capacity;
+
 	ht_index_t candidate_index = 0, multiplier = HASH_FUNCTION_A;
 
-	for (; *key != '\0'; ++key)
+	for (unsigned long k = 0; k < hashed_len; ++k)
 	{
-		candidate_index = (multiplier * candidate_index + *key) % ht->capacity;
+		candidate_index = (multiplier * candidate_index + key[k]) % ht->capacity;
 		multiplier = (multiplier * HASH_FUNCTION_B) % (ht->capacity - 1);
 	}
 
@@ -111,34 +253,102 @@ bool item_at_index_has_key(const HashTable_t* ht, const ht_index_t i, const char
 	return ht->states[i] == OCCUPIED && article_has_key(ht->items[i], key);
 }
 
+bool item_at_index_has_key_n(const HashTable_t* ht, const ht_index_t i, const char* const key, const unsigned long len)
+{
+	return ht->states[i] == OCCUPIED && article_has_key_n(ht->items[i], key, len);
+}
+
 ht_index_t next_index_in_cycle(const HashTable_t* const ht, const ht_index_t i)
 {
 	return (i + 1) % ht->capacity;
 }
 
-ht_index_t find_index_of_key(const HashTable_t* const ht, const char* const key)
+ht_index_t probes_between(const HashTable_t* const ht, const ht_index_t from, const ht_index_t to)
+{
+	return (to + ht->capacity - from) % ht->capacity + 1;
+}
+
+unsigned long long filter_hash_of(const char* const key, const unsigned long len)
+{
+	return kh_hash_bytes(key, stored_key_length(len), HT_FILTER_SEED);
+}
+
+HtKeyHash_t ht_key_hash(const HashTable_t* const ht, const char* const key, const unsigned long len)
+{
+	// The filter hash is only worth computing for tables that have a filter
+	const HtKeyHash_t hash = {
+			ht_hash_key(ht, key, len), ht->filter != NULL ? filter_hash_of(key, len) : 0, ht->generation
+	};
+	return hash;
+}
+
+bool filter_rules_out_hash(const HashTable_t* const ht, const unsigned long long filter_hash)
+{
+	return ht->filter != NULL && !mf_may_contain(ht->filter, filter_hash);
+}
+
+ht_index_t probe_for_key(
+		const HashTable_t* const ht, const char* const key, const unsigned long len, const ht_index_t hashed_index)
 {
-	ht_index_t const hashed_index = ht_hash_key(ht, key);
 	ht_index_t current_index = hashed_index;
 
 	do
 	{
 		if (ht->states[current_index] == OPEN)
-			return HT_KEY_NOT_FOUND;
+			break;
 
-		if (item_at_index_has_key(ht, current_index, key))
+		if (item_at_index_has_key_n(ht, current_index, key, len))
+		{
+			HT_STATS_PROBES(ht, probes_between(ht, hashed_index, current_index));
 			return current_index;
+		}
 
 		current_index = next_index_in_cycle(ht, current_index);
 
 	} while (current_index != hashed_index);
 
+	HT_STATS_PROBES(ht, probes_between(ht, hashed_index, current_index));
 	return HT_KEY_NOT_FOUND;
 }
 
+ht_index_t find_index_of_hashed_key(
+		const HashTable_t* const ht, const char* const key, const unsigned long len, HtKeyHash_t hash)
+{
+	// Hashes from before the keys last moved point at the wrong chain
+	if (hash.generation != ht->generation || hash.slot >= ht->capacity)
+		hash = ht_key_hash(ht, key, len);
+
+	if (filter_rules_out_hash(ht, hash.filter_hash))
+		return HT_KEY_NOT_FOUND;
+
+	return probe_for_key(ht, key, len, hash.slot);
+}
+
+ht_index_t find_index_of_key_n(const HashTable_t* const ht, const char* const key, const unsigned long len)
+{
+	// The filter hash is one cheap pass; the slot hash only pays off for keys the filter lets through
+	if (ht->filter != NULL && filter_rules_out_hash(ht, filter_hash_of(key, len)))
+		return HT_KEY_NOT_FOUND;
+
+	return probe_for_key(ht, key, len, ht_hash_key(ht, key, len));
+}
+
+ht_index_t find_index_of_key(const HashTable_t* const ht, const char* const key)
+{
+	return find_index_of_key_n(ht, key, strlen(key));
+}
+
+bool ht_contains_n(const HashTable_t* const ht, const char* const key, const unsigned long len)
+{
+	HT_STATS_BEGIN(ht, HT_OP_FETCH);
+	const bool found = find_index_of_key_n(ht, key, len) != HT_KEY_NOT_FOUND;
+	HT_STATS_END();
+	return found;
+}
+
 bool ht_contains(const HashTable_t* const ht, const char* key)
 {
-	return find_index_of_key(ht, key) != HT_KEY_NOT_FOUND;
+	return ht_contains_n(ht, key, strlen(key));
 }
 
 unsigned long ht_count(const HashTable_t* const ht)
@@ -151,61 +361,255 @@ unsigned long ht_capacity(const HashTable_t* ht)
 	return ht->capacity;
 }
 
+void account_cache_lookup(const HashTable_t* const ht, const ht_index_t i)
+{
+	// Cache state sits behind pointers, so lookups on a const table may still update it
+	if (ht->cache == NULL)
+		return;
+
+	if (i == HT_KEY_NOT_FOUND)
+	{
+		ht->cache->misses++;
+		return;
+	}
+
+	ht->cache->hits++;
+	ht->reference_bits[i] = 1;
+}
+
+const Article_t* ht_fetch_hashed(
+		const HashTable_t* const ht, const char* const key, const unsigned long len, const HtKeyHash_t hash)
+{
+	HT_STATS_BEGIN(ht, HT_OP_FETCH);
+	const ht_index_t i = find_index_of_hashed_key(ht, key, len, hash);
+	account_cache_lookup(ht, i);
+	HT_STATS_END();
+	return i != HT_KEY_NOT_FOUND ? ht->items[i] : NULL;
+}
+
+const Article_t* ht_fetch_n(const HashTable_t* const ht, const char* const key, const unsigned long len)
+{
+	HT_STATS_BEGIN(ht, HT_OP_FETCH);
+	const ht_index_t i = find_index_of_key_n(ht, key, len);
+	account_cache_lookup(ht, i);
+	HT_STATS_END();
+	return i != HT_KEY_NOT_FOUND ? ht->items[i] : NULL;
+}
+
 const Article_t* ht_fetch(const HashTable_t* const ht, const char* const key)
 {
+	return ht_fetch_n(ht, key, strlen(key));
+}
+
+const Article_t* ht_cache_fetch(HashTable_t* const ht, const char* const key)
+{
+	const Article_t* const cached = ht_fetch(ht, key);
+
+	if (cached != NULL || ht->cache == NULL || ht->cache->loader == NULL)
+		return cached;
+
+	Article_t* const loaded = ht->cache->loader(key, ht->cache->loader_context);
+
+	if (loaded == NULL)
+		return NULL;
+
+	ht_insert(ht, loaded);
+	delete_article(loaded);
+
 	const ht_index_t i = find_index_of_key(ht, key);
 	return i != HT_KEY_NOT_FOUND ? ht->items[i] : NULL;
 }
 
+unsigned long ht_cache_hits(const HashTable_t* const ht)
+{
+	return ht->cache != NULL ? ht->cache->hits : 0;
+}
+
+unsigned long ht_cache_misses(const HashTable_t* const ht)
+{
+	return ht->cache != NULL ? ht->cache->misses : 0;
+}
+
+unsigned long ht_cache_evictions(const HashTable_t* const ht)
+{
+	return ht->cache != NULL ? ht->cache->evictions : 0;
+}
+
+void ht_read_stats(const HashTable_t* const ht, HtStats_t* const out)
+{
+#ifdef HT_INSTRUMENTATION
+	ht_stats_collect(ht->stats, out);
+#else
+	(void)ht;
+	memset(out, 0, sizeof(HtStats_t));
+#endif
+}
+
 double ht_density(const HashTable_t* const ht)
 {
 	return ((double)ht->count) / ht->capacity;
 }
 
+double ht_density_with_removed(const HashTable_t* const ht)
+{
+	return ((double)(ht->count + ht->removed)) / ht->capacity;
+}
+
 void expand_if_density_is_high(HashTable_t* const ht)
 {
 	if (ht_density(ht) > HT_HIGH_DENSITY_BOUND)
 		ht_expand(ht);
+	else if (ht_density_with_removed(ht) > HT_HIGH_DENSITY_BOUND)
+		ht_resize(ht, ht->capacity); // Same capacity, but clears REMOVED cells so probe chains end again
 }
 
-void insert_item_at_index(HashTable_t* const ht, const Article_t* const article, const ht_index_t i)
+// Takes ownership of item
+void place_item_at_index(HashTable_t* const ht, Article_t* const item, const ht_index_t i)
 {
-	ht->items[i] = duplicate_article(article);
+	if (ht->states[i] == REMOVED)
+		ht->removed--;
+
+	ht->items[i] = item;
 	ht->states[i] = OCCUPIED;
 	ht->count++;
+	ht->inserts_since_reseed++;
+
+	if (ht->reference_bits != NULL)
+		ht->reference_bits[i] = 0;
+
+	if (ht->filter != NULL)
+		mf_add(ht->filter, filter_hash_of(key_of(item), key_length_of(item)));
+}
+
+void insert_item_at_index(HashTable_t* const ht, const Article_t* const article, const ht_index_t i)
+{
+	place_item_at_index(ht, duplicate_article(article), i);
+	HT_STATS_ALLOCATIONS(ht, 1);
 }
 
 void replace_item_at_index(HashTable_t* const ht, const Article_t* const article, const ht_index_t i)
 {
-	delete_article(ht->items[i]);
+	release_item(ht, ht->items[i]);
 	ht->items[i] = duplicate_article(article);
+	HT_STATS_ALLOCATIONS(ht, 1);
+}
+
+void remove_item_at_index(HashTable_t* const ht, const ht_index_t i)
+{
+	if (ht->filter != NULL)
+		mf_remove(ht->filter, filter_hash_of(key_of(ht->items[i]), key_length_of(ht->items[i])));
+
+	release_item(ht, ht->items[i]);
+	ht->states[i] = REMOVED;
+	ht->count--;
+	ht->removed++;
+}
+
+ht_index_t advance_clock_hand(const HashTable_t* const ht)
+{
+	const ht_index_t i = ht->cache->clock_hand;
+	ht->cache->clock_hand = next_index_in_cycle(ht, i);
+	return i;
+}
+
+void evict_one_item(HashTable_t* const ht)
+{
+	// CLOCK: referenced items lose their bit and are passed over once, the first unreferenced one goes
+	// Every pass clears the bits it skips, so the hand moves O(1) cells per eviction on average
+	for (;;)
+	{
+		const ht_index_t i = advance_clock_hand(ht);
+
+		if (ht->states[i] != OCCUPIED)
+			continue;
+
+		if (ht->reference_bits[i])
+		{
+			ht->reference_bits[i] = 0;
+			continue;
+		}
+
+		remove_item_at_index(ht, i);
+		ht->cache->evictions++;
+		return;
+	}
+}
+
+void evict_if_cache_is_full(HashTable_t* const ht, const Article_t* const incoming)
+{
+	if (ht->cache == NULL || ht->count < ht->cache->item_limit)
+		return;
+
+	// Replacing a cached key does not grow the table
+	if (find_index_of_key_n(ht, key_of(incoming), key_length_of(incoming)) == HT_KEY_NOT_FOUND)
+		evict_one_item(ht);
+}
+
+ht_index_t probe_limit(const HashTable_t* const ht)
+{
+	ht_index_t capacity_bits = 0;
+
+	for (ht_index_t c = ht->capacity; c != 0; c >>= 1)
+		capacity_bits++;
+
+	return HT_PROBE_LIMIT_PER_CAPACITY_BIT * capacity_bits;
+}
+
+void reseed_if_probe_was_long(HashTable_t* const ht, const ht_index_t probes)
+{
+	// Waiting for count new inserts between reseeds keeps the rehash cost amortized O(1)
+	if (probes <= probe_limit(ht) || ht->inserts_since_reseed < ht->count)
+		return;
+
+	// Fixed-constant tables switch to the keyed hash; keyed ones draw a fresh seed
+	ht->seeded_hash = true;
+	ht->seed = kh_random_seed();
+	ht_resize(ht, ht->capacity);
+	ht->inserts_since_reseed = 0;
+}
+
+bool ht_is_seeded(const HashTable_t* const ht)
+{
+	return ht->seeded_hash;
 }
 
 void ht_insert(HashTable_t* const ht, const Article_t* const article)
 {
+	HT_STATS_BEGIN(ht, HT_OP_INSERT);
+	evict_if_cache_is_full(ht, article);
 	expand_if_density_is_high(ht);
 
-	ht_index_t const hashed_index = ht_hash_key(ht, key_of(article));
+	ht_index_t const hashed_index = ht_hash_key(ht, key_of(article), key_length_of(article));
 	ht_index_t current_index = hashed_index;
+	ht_index_t first_removed_index = HT_KEY_NOT_FOUND;
 
 	do
 	{
 		if (ht->states[current_index] == OPEN)
-			return insert_item_at_index(ht, article, current_index);
+			break;
 
 		if (item_at_index_has_key(ht, current_index, key_of(article)))
-			return replace_item_at_index(ht, article, current_index);
+			break;
+
+		if (ht->states[current_index] == REMOVED && first_removed_index == HT_KEY_NOT_FOUND)
+			first_removed_index = current_index;
 
 		current_index = next_index_in_cycle(ht, current_index);
 
 	} while (current_index != hashed_index);
-}
 
-void remove_item_at_index(HashTable_t* const ht, const ht_index_t i)
-{
-	delete_article(ht->items[i]);
-	ht->states[i] = REMOVED;
-	ht->count--;
+	HT_STATS_PROBES(ht, probes_between(ht, hashed_index, current_index));
+
+	// New keys reuse the first REMOVED cell of the chain, if any
+	if (item_at_index_has_key(ht, current_index, key_of(article)))
+		replace_item_at_index(ht, article, current_index);
+	else if (first_removed_index != HT_KEY_NOT_FOUND)
+		insert_item_at_index(ht, article, first_removed_index);
+	else if (ht->states[current_index] == OPEN)
+		insert_item_at_index(ht, article, current_index);
+
+	reseed_if_probe_was_long(ht, probes_between(ht, hashed_index, current_index));
+	HT_STATS_END();
 }
 
 void shrink_if_density_is_low(HashTable_t* const ht)
@@ -214,15 +618,36 @@ void shrink_if_density_is_low(HashTable_t* const ht)
 		ht_shrink(ht);
 }
 
+void ht_remove_n(HashTable_t* const ht, const char* const key, const unsigned long len)
+{
+	HT_STATS_BEGIN(ht, HT_OP_REMOVE);
+	const ht_index_t i = find_index_of_key_n(ht, key, len);
+
+	if (i != HT_KEY_NOT_FOUND)
+	{
+		remove_item_at_index(ht, i);
+		shrink_if_density_is_low(ht);
+	}
+
+	HT_STATS_END();
+}
+
 void ht_remove(HashTable_t* const ht, const char* const key)
 {
-	const ht_index_t i = find_index_of_key(ht, key);
+	ht_remove_n(ht, key, strlen(key));
+}
 
-	if (i == HT_KEY_NOT_FOUND)
-		return;
+// For keys known to be absent, the first cell not OCCUPIED will do
+ht_index_t find_free_index_for_new_key(const HashTable_t* const ht, const Article_t* const item)
+{
+	ht_index_t const hashed_index = ht_hash_key(ht, key_of(item), key_length_of(item));
+	ht_index_t current_index = hashed_index;
 
-	remove_item_at_index(ht, i);
-	shrink_if_density_is_low(ht);
+	while (ht->states[current_index] == OCCUPIED)
+		current_index = next_index_in_cycle(ht, current_index);
+
+	HT_STATS_PROBES(ht, probes_between(ht, hashed_index, current_index));
+	return current_index;
 }
 
 void ht_resize(HashTable_t* const ht, const ht_index_t new_capacity)
@@ -230,40 +655,99 @@ void ht_resize(HashTable_t* const ht, const ht_index_t new_capacity)
 	if (new_capacity == 0 || new_capacity < ht->count)
 		return;
 
+	HT_STATS_BEGIN(ht, HT_OP_RESIZE);
 	HashTable_t old_table = *ht;
 
 	ht->count = 0;
+	ht->removed = 0;
 	ht->capacity = new_capacity;
 	alloc_and_init_items_and_states(ht);
 
+	// Articles move over as they are: no copies, and arena articles stay in the arena
 	for (ht_index_t i = 0, transferred = 0;
 		 i < old_table.capacity && transferred < old_table.count; ++i)
 	{
 		if (old_table.states[i] == OCCUPIED)
 		{
-			ht_insert(ht, old_table.items[i]);
+			place_item_at_index(ht, old_table.items[i], find_free_index_for_new_key(ht, old_table.items[i]));
 			transferred++;
 		}
 	}
 
-	delete_and_free_items_and_states(&old_table);
+	free_items_and_states(&old_table);
+	HT_STATS_END();
 }
 
 void ht_expand(HashTable_t* const ht)
 {
-	if (ht->capacity_index != HT_MAXIMUM_CAPACITY_INDEX)
+	if (ht->capacity_index != maximum_capacity_index())
 		ht_resize(ht, calculate_optimal_capacity_for_index(++ht->capacity_index));
 }
 
 void ht_shrink(HashTable_t* const ht)
 {
-	if (ht->capacity_index != 0)
+	if (ht->capacity_index > minimum_capacity_index(ht))
 		ht_resize(ht, calculate_optimal_capacity_for_index(--ht->capacity_index));
 }
 
+void repack_items_into_arena(HashTable_t* const ht)
+{
+	if (ht->count == 0)
+		return;
+
+	Article_t* const arena = make_article_block(ht->count);
+	HT_STATS_ALLOCATIONS(ht, 1);
+
+	// Slot order, so a scan or a probe chain reads neighbouring articles from neighbouring memory
+	for (ht_index_t i = 0, packed = 0; i < ht->capacity && packed < ht->count; ++i)
+	{
+		if (ht->states[i] == OCCUPIED)
+		{
+			Article_t* const target = article_in_block(arena, packed++);
+			copy_article(ht->items[i], target);
+			release_item(ht, ht->items[i]);
+			ht->items[i] = target;
+		}
+	}
+
+	// The previous arena went away with its last article above
+	ht->arena = arena;
+	ht->arena_size = ht->count;
+	ht->arena_live = ht->count;
+}
+
+void ht_compact(HashTable_t* const ht)
+{
+	const unsigned short fitting_index = smallest_capacity_index_for(ht->count, HT_HIGH_DENSITY_BOUND);
+	const unsigned short minimum_index = minimum_capacity_index(ht);
+
+	ht->capacity_index = fitting_index > minimum_index ? fitting_index : minimum_index;
+	ht_resize(ht, calculate_optimal_capacity_for_index(ht->capacity_index));
+	repack_items_into_arena(ht);
+}
+
+HtMemoryUsage_t ht_memory_usage(const HashTable_t* const ht)
+{
+	HtMemoryUsage_t usage;
+
+	usage.slots = ht->items_memory.size + ht->states_memory.size;
+
+	usage.metadata = sizeof(HashTable_t);
+	if (ht->filter != NULL)
+		usage.metadata += mf_size_in_bytes(ht->filter);
+	if (ht->cache != NULL)
+		usage.metadata += sizeof(CacheState_t) + ht->capacity * sizeof(unsigned char);
+
+	// Arena slots of removed articles stay allocated until the whole arena goes
+	usage.articles = (ht->count - ht->arena_live + ht->arena_size) * article_footprint();
+
+	usage.total = usage.slots + usage.metadata + usage.articles;
+	return usage;
+}
+
 bool item_at_index_was_hashed_directly(const HashTable_t* const ht, const ht_index_t i)
 {
-	return ht_hash_key(ht, key_of(ht->items[i])) == i;
+	return ht_hash_key(ht, key_of(ht->items[i]), key_length_of(ht->items[i])) == i;
 }
 
 void ht_display_states(const HashTable_t* const ht, FILE* out)
@@ -324,16 +808,19 @@ ht_index_t read_capacity(FILE* const in)
 HashTable_t* ht_from_file(FILE* const in)
 {
 	HashTable_t* ht = ht_new();
+	HT_STATS_BEGIN(ht, HT_OP_LOAD);
 
 	ht_resize(ht, read_capacity(in));
 
 	while (!feof(in))
 	{
 		Article_t* a = article_from_file(in);
+		HT_STATS_ALLOCATIONS(ht, 1);
 		ht_insert(ht, a);
 		delete_article(a);
 	}
 
+	HT_STATS_END();
 	return ht;
 }
 
@@ -345,3 +832,200 @@ void ht_dump(const HashTable_t* ht, FILE* const out)
 		if (ht->states[i] == OCCUPIED)
 			dump_article(ht->items[i], out);
 }
+
+FrozenTable_t* ht_freeze(const HashTable_t* const ht)
+{
+	const Article_t** const articles = (const Article_t**)malloc((ht->count + 1) * sizeof(Article_t*));
+	ht_index_t collected = 0;
+
+	for (ht_index_t i = 0; i < ht->capacity && collected < ht->count; ++i)
+		if (ht->states[i] == OCCUPIED)
+			articles[collected++] = ht->items[i];
+
+	FrozenTable_t* const frozen = fz_build(articles, collected);
+	free(articles);
+	return frozen;
+}
+
+typedef struct LookupRange_s
+{
+	const HashTable_t* source;
+	const HashTable_t* target;
+	ht_index_t first;
+	ht_index_t last;
+	ht_index_t* found; // Per source slot: where its key sits in target, or HT_KEY_NOT_FOUND
+} LookupRange_t;
+
+void* look_up_range(void* const argument)
+{
+	const LookupRange_t* const range = (const LookupRange_t*)argument;
+
+	for (ht_index_t i = range->first; i < range->last; ++i)
+		if (range->source->states[i] == OCCUPIED)
+		{
+			const Article_t* const item = range->source->items[i];
+			range->found[i] = find_index_of_key_n(range->target, key_of(item), key_length_of(item));
+		}
+
+	return NULL;
+}
+
+unsigned long lookup_thread_count(const ht_index_t slots)
+{
+	if (ht_forced_lookup_threads != 0)
+		return ht_forced_lookup_threads;
+
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (threads > HT_MAX_LOOKUP_THREADS)
+		threads = HT_MAX_LOOKUP_THREADS;
+	if (threads < 1 || slots / HT_MIN_SLOTS_PER_LOOKUP_THREAD < (unsigned long)threads)
+		threads = (long)(slots / HT_MIN_SLOTS_PER_LOOKUP_THREAD);
+
+	return threads > 1 ? (unsigned long)threads : 1;
+}
+
+// Looks every source key up in target; neither table may change meanwhile
+// Source slots are split into contiguous ranges, which for a hashed table are hash ranges
+ht_index_t* look_up_all_keys(const HashTable_t* const source, const HashTable_t* const target)
+{
+	ht_index_t* const found = (ht_index_t*)malloc(source->capacity * sizeof(ht_index_t));
+	const unsigned long threads = lookup_thread_count(source->capacity);
+	LookupRange_t* const ranges = (LookupRange_t*)malloc(threads * sizeof(LookupRange_t));
+	pthread_t* const workers = (pthread_t*)malloc(threads * sizeof(pthread_t));
+	bool* const started = (bool*)calloc(threads, sizeof(bool));
+
+	for (unsigned long t = 0; t < threads; ++t)
+	{
+		const LookupRange_t range = {
+				source, target, source->capacity * t / threads, source->capacity * (t + 1) / threads, found
+		};
+		ranges[t] = range;
+	}
+
+	// The calling thread takes the first range; any range whose thread fails to start runs here too
+	for (unsigned long t = 1; t < threads; ++t)
+		started[t] = pthread_create(&workers[t], NULL, look_up_range, &ranges[t]) == 0;
+
+	look_up_range(&ranges[0]);
+
+	for (unsigned long t = 1; t < threads; ++t)
+	{
+		if (started[t])
+			pthread_join(workers[t], NULL);
+		else
+			look_up_range(&ranges[t]);
+	}
+
+	free(ranges);
+	free(workers);
+	free(started);
+	return found;
+}
+
+// Hands over the article in slot i; arena articles cannot leave their block, so those are copied
+Article_t* take_item_at_index(HashTable_t* const ht, const ht_index_t i)
+{
+	if (!item_is_in_arena(ht, ht->items[i]))
+		return ht->items[i];
+
+	Article_t* const copy = duplicate_article(ht->items[i]);
+	HT_STATS_ALLOCATIONS(ht, 1);
+	release_item(ht, ht->items[i]);
+	return copy;
+}
+
+void reset_to_empty(HashTable_t* const ht)
+{
+	free_items_and_states(ht);
+	ht->count = 0;
+	ht->removed = 0;
+	ht->capacity_index = minimum_capacity_index(ht);
+	ht->capacity = calculate_optimal_capacity_for_index(ht->capacity_index);
+	alloc_and_init_items_and_states(ht);
+}
+
+void ht_merge(HashTable_t* const dst, HashTable_t* const src, const HtMergePolicy_t policy)
+{
+	if (dst == src)
+		return;
+
+	HT_STATS_BEGIN(dst, HT_OP_INSERT);
+
+	// Room for every source key up front, so the loop below never resizes
+	const unsigned short needed_index = smallest_capacity_index_for(dst->count + src->count, HT_HIGH_DENSITY_BOUND);
+	if (needed_index > dst->capacity_index)
+	{
+		dst->capacity_index = needed_index;
+		ht_resize(dst, calculate_optimal_capacity_for_index(needed_index));
+	}
+
+	ht_index_t* const found = look_up_all_keys(src, dst);
+
+	for (ht_index_t i = 0; i < src->capacity; ++i)
+	{
+		if (src->states[i] != OCCUPIED)
+			continue;
+
+		const ht_index_t j = found[i];
+
+		if (j == HT_KEY_NOT_FOUND)
+		{
+			Article_t* const item = take_item_at_index(src, i);
+			place_item_at_index(dst, item, find_free_index_for_new_key(dst, item));
+		}
+		else if (policy == HT_MERGE_TAKE_SOURCE)
+		{
+			release_item(dst, dst->items[j]);
+			dst->items[j] = take_item_at_index(src, i);
+		}
+		else
+			release_item(src, src->items[i]);
+	}
+
+	free(found);
+	reset_to_empty(src);
+
+	while (dst->cache != NULL && dst->count > dst->cache->item_limit)
+		evict_one_item(dst);
+
+	HT_STATS_END();
+}
+
+HtDiff_t ht_diff(const HashTable_t* const a, const HashTable_t* const b)
+{
+	// Sized for the worst case, so collecting never reallocates
+	HtDiff_t diff = {
+			(const Article_t**)malloc((b->count + 1) * sizeof(Article_t*)), 0,
+			(const Article_t**)malloc((a->count + 1) * sizeof(Article_t*)), 0,
+			(const Article_t**)malloc((b->count + 1) * sizeof(Article_t*)), 0
+	};
+	ht_index_t* const found_in_a = look_up_all_keys(b, a);
+	ht_index_t* const found_in_b = look_up_all_keys(a, b);
+
+	for (ht_index_t i = 0; i < b->capacity; ++i)
+	{
+		if (b->states[i] != OCCUPIED)
+			continue;
+
+		if (found_in_a[i] == HT_KEY_NOT_FOUND)
+			diff.added[diff.added_count++] = b->items[i];
+		else if (!articles_are_equal(a->items[found_in_a[i]], b->items[i]))
+			diff.changed[diff.changed_count++] = b->items[i];
+	}
+
+	for (ht_index_t i = 0; i < a->capacity; ++i)
+		if (a->states[i] == OCCUPIED && found_in_b[i] == HT_KEY_NOT_FOUND)
+			diff.removed[diff.removed_count++] = a->items[i];
+
+	free(found_in_a);
+	free(found_in_b);
+	return diff;
+}
+
+void ht_free_diff(HtDiff_t* const diff)
+{
+	free((void*)diff->added);
+	free((void*)diff->removed);
+	free((void*)diff->changed);
+}
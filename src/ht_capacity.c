@@ -0,0 +1,22 @@
+#include "ht_capacity.h"
+
+// Deltas are such that 2 ^ (i + 4) - deltas[i] is a prime
+// Keeping capacity as a prime is good for hash function dispersion
+static const unsigned short capacity_deltas[] =
+		{
+				3, 1, 3, 1, 5, 3, 3,
+				9, 3, 1, 3, 19, 15, 1, 5, 1, 3,
+				9, 3, 15, 3, 39, 5, 39, 57, 3, 35,
+				1, 5, 9, 41, 31, 5, 25, 45, 7, 87,
+				21, 11, 57, 17, 55, 21, 115, 59, 81, 27
+		};
+
+unsigned long calculate_optimal_capacity_for_index(unsigned short index)
+{
+	return (1lu << (index + 4)) - capacity_deltas[index];
+}
+
+unsigned short maximum_capacity_index(void)
+{
+	return sizeof capacity_deltas / sizeof *capacity_deltas - 1;
+}
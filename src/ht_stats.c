@@ -0,0 +1,192 @@
+#include "ht_stats.h"
+
+#ifdef HT_INSTRUMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define CACHE_LINE_SIZE 64
+
+struct HtStatsShard_s
+{
+	alignas(CACHE_LINE_SIZE) const void* thread_marker;
+	HtStatsShard_t* next;
+	HtOperation_t current;
+	HtStats_t stats;
+};
+
+struct HtStatsRegistry_s
+{
+	_Atomic(HtStatsShard_t*) shards;
+	unsigned long long id;
+};
+
+// The address of a thread-local is unique among live threads, so it doubles as a thread id
+static _Thread_local char thread_marker;
+
+// Most threads hammer a single table, so the last registry/shard pair is remembered
+static _Thread_local const HtStatsRegistry_t* cached_registry;
+static _Thread_local unsigned long long cached_registry_id;
+static _Thread_local HtStatsShard_t* cached_shard;
+
+static atomic_ullong next_registry_id = 1;
+
+HtStatsRegistry_t* ht_stats_new_registry(void)
+{
+	HtStatsRegistry_t* const registry = (HtStatsRegistry_t*)malloc(sizeof(HtStatsRegistry_t));
+	atomic_init(&registry->shards, NULL);
+	registry->id = atomic_fetch_add(&next_registry_id, 1);
+	return registry;
+}
+
+void ht_stats_delete_registry(HtStatsRegistry_t* const registry)
+{
+	HtStatsShard_t* shard = atomic_load(&registry->shards);
+
+	while (shard != NULL)
+	{
+		HtStatsShard_t* const next = shard->next;
+		free(shard);
+		shard = next;
+	}
+
+	free(registry);
+}
+
+HtStatsShard_t* make_shard(void)
+{
+	HtStatsShard_t* const shard = (HtStatsShard_t*)aligned_alloc(CACHE_LINE_SIZE, sizeof(HtStatsShard_t));
+	memset(shard, 0, sizeof(HtStatsShard_t));
+	shard->thread_marker = &thread_marker;
+	shard->current = HT_OP_COUNT;
+	return shard;
+}
+
+HtStatsShard_t* find_shard_of_this_thread(HtStatsRegistry_t* const registry)
+{
+	for (HtStatsShard_t* shard = atomic_load(&registry->shards); shard != NULL; shard = shard->next)
+		if (shard->thread_marker == &thread_marker)
+			return shard;
+
+	HtStatsShard_t* const shard = make_shard();
+	shard->next = atomic_load(&registry->shards);
+	while (!atomic_compare_exchange_weak(&registry->shards, &shard->next, shard));
+
+	return shard;
+}
+
+HtStatsShard_t* shard_of_this_thread(HtStatsRegistry_t* const registry)
+{
+	if (cached_registry != registry || cached_registry_id != registry->id)
+	{
+		cached_shard = find_shard_of_this_thread(registry);
+		cached_registry = registry;
+		cached_registry_id = registry->id;
+	}
+
+	return cached_shard;
+}
+
+unsigned long long monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000llu + ts.tv_nsec;
+}
+
+unsigned latency_bucket(unsigned long long ns)
+{
+	unsigned bucket = 0;
+
+	while (ns >>= 1)
+		bucket++;
+
+	return bucket < HT_LATENCY_BUCKETS ? bucket : HT_LATENCY_BUCKETS - 1;
+}
+
+int is_absorbed_by(const HtOperation_t running, const HtOperation_t operation)
+{
+	if (running == HT_OP_RESIZE)
+		return 1;
+
+	return running == HT_OP_LOAD && operation != HT_OP_RESIZE;
+}
+
+HtStatsScope_t ht_stats_begin(HtStatsRegistry_t* const registry, const HtOperation_t operation)
+{
+	HtStatsShard_t* const shard = shard_of_this_thread(registry);
+	HtStatsScope_t scope = { shard, shard->current, 0, 0 };
+
+	if (shard->current != HT_OP_COUNT && is_absorbed_by(shard->current, operation))
+		return scope;
+
+	scope.recorded = 1;
+	shard->current = operation;
+	scope.start_ns = monotonic_ns();
+
+	return scope;
+}
+
+void ht_stats_end(HtStatsScope_t* const scope)
+{
+	if (!scope->recorded)
+		return;
+
+	const unsigned long long elapsed = monotonic_ns() - scope->start_ns;
+	HtOperationStats_t* const op = &scope->shard->stats.operations[scope->shard->current];
+
+	op->calls++;
+	op->total_ns += elapsed;
+	if (elapsed > op->max_ns)
+		op->max_ns = elapsed;
+	op->latency_histogram[latency_bucket(elapsed)]++;
+
+	scope->shard->current = scope->previous;
+}
+
+void ht_stats_add_probes(HtStatsRegistry_t* const registry, const unsigned long probes)
+{
+	HtStatsShard_t* const shard = shard_of_this_thread(registry);
+
+	if (shard->current != HT_OP_COUNT)
+		shard->stats.operations[shard->current].probes += probes;
+}
+
+void ht_stats_add_allocations(HtStatsRegistry_t* const registry, const unsigned long allocations)
+{
+	HtStatsShard_t* const shard = shard_of_this_thread(registry);
+
+	if (shard->current != HT_OP_COUNT)
+		shard->stats.operations[shard->current].allocations += allocations;
+}
+
+void ht_stats_collect(const HtStatsRegistry_t* const registry, HtStats_t* const out)
+{
+	memset(out, 0, sizeof(HtStats_t));
+
+	// Shards are summed without stopping writers: totals may lag by in-flight operations
+	for (const HtStatsShard_t* shard = atomic_load(&((HtStatsRegistry_t*)registry)->shards);
+		 shard != NULL; shard = shard->next)
+	{
+		for (int o = 0; o < HT_OP_COUNT; ++o)
+		{
+			const HtOperationStats_t* const from = &shard->stats.operations[o];
+			HtOperationStats_t* const to = &out->operations[o];
+
+			to->calls += from->calls;
+			to->probes += from->probes;
+			to->allocations += from->allocations;
+			to->total_ns += from->total_ns;
+			if (from->max_ns > to->max_ns)
+				to->max_ns = from->max_ns;
+
+			for (int b = 0; b < HT_LATENCY_BUCKETS; ++b)
+				to->latency_histogram[b] += from->latency_histogram[b];
+		}
+	}
+}
+
+#endif //HT_INSTRUMENTATION
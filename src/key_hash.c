@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/random.h>
+
+#include "key_hash.h"
+
+static const unsigned long long FNV_OFFSET_BASIS = 0xCBF29CE484222325llu;
+static const unsigned long long FNV_PRIME = 0x100000001B3llu;
+
+unsigned long long kh_mix(unsigned long long h)
+{
+	// Finalizer from MurmurHash3: spreads every input bit over the whole word
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDllu;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53llu;
+	h ^= h >> 33;
+	return h;
+}
+
+unsigned long long kh_hash_bytes(const char* const key, const unsigned long len, const unsigned long long seed)
+{
+	unsigned long long h = FNV_OFFSET_BASIS ^ kh_mix(seed);
+
+	for (unsigned long i = 0; i < len; ++i)
+	{
+		h ^= (unsigned char)key[i];
+		h *= FNV_PRIME;
+	}
+
+	return kh_mix(h ^ len);
+}
+
+unsigned long long kh_hash_string(const char* const key, const unsigned long long seed)
+{
+	return kh_hash_bytes(key, strlen(key), seed);
+}
+
+KeyHashSeed_t kh_random_seed(void)
+{
+	KeyHashSeed_t seed = { 0, 0 };
+
+	if (getrandom(&seed, sizeof seed, 0) == sizeof seed)
+		return seed;
+
+	FILE* const urandom = fopen("/dev/urandom", "rb");
+	if (urandom != NULL)
+	{
+		const size_t read = fread(&seed, sizeof seed, 1, urandom);
+		fclose(urandom);
+		if (read == 1)
+			return seed;
+	}
+
+	// Last resort is merely unpredictable to a remote sender, not cryptographically random
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	seed.k0 = kh_mix((unsigned long long)ts.tv_nsec ^ (unsigned long long)(size_t)&seed);
+	seed.k1 = kh_mix((unsigned long long)ts.tv_sec ^ (unsigned long long)time(NULL) ^ seed.k0);
+	return seed;
+}
+
+#define ROTATE_LEFT(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+typedef struct SipState_s
+{
+	unsigned long long v0, v1, v2, v3;
+} SipState_t;
+
+void sip_round(SipState_t* const s)
+{
+	s->v0 += s->v1;
+	s->v1 = ROTATE_LEFT(s->v1, 13);
+	s->v1 ^= s->v0;
+	s->v0 = ROTATE_LEFT(s->v0, 32);
+	s->v2 += s->v3;
+	s->v3 = ROTATE_LEFT(s->v3, 16);
+	s->v3 ^= s->v2;
+	s->v0 += s->v3;
+	s->v3 = ROTATE_LEFT(s->v3, 21);
+	s->v3 ^= s->v0;
+	s->v2 += s->v1;
+	s->v1 = ROTATE_LEFT(s->v1, 17);
+	s->v1 ^= s->v2;
+	s->v2 = ROTATE_LEFT(s->v2, 32);
+}
+
+unsigned long long read_little_endian_64(const unsigned char* const p)
+{
+	unsigned long long word = 0;
+
+	for (int i = 7; i >= 0; --i)
+		word = word << 8 | p[i];
+
+	return word;
+}
+
+void sip_absorb(SipState_t* const s, const unsigned long long m)
+{
+	s->v3 ^= m;
+	sip_round(s);
+	s->v0 ^= m;
+}
+
+// SipHash-1-3: one compression round per word and three finalization rounds
+unsigned long long kh_siphash_bytes(const char* const key, const unsigned long len, const KeyHashSeed_t* const seed)
+{
+	SipState_t s = {
+			seed->k0 ^ 0x736F6D6570736575llu, seed->k1 ^ 0x646F72616E646F6Dllu,
+			seed->k0 ^ 0x6C7967656E657261llu, seed->k1 ^ 0x7465646279746573llu
+	};
+	const unsigned char* const bytes = (const unsigned char*)key;
+	const unsigned long full_words = len / 8;
+
+	for (unsigned long w = 0; w < full_words; ++w)
+		sip_absorb(&s, read_little_endian_64(bytes + 8 * w));
+
+	unsigned long long last = (unsigned long long)len << 56;
+	for (unsigned long i = 0; i < len % 8; ++i)
+		last |= (unsigned long long)bytes[8 * full_words + i] << (8 * i);
+	sip_absorb(&s, last);
+
+	s.v2 ^= 0xFF;
+	sip_round(&s);
+	sip_round(&s);
+	sip_round(&s);
+
+	return s.v0 ^ s.v1 ^ s.v2 ^ s.v3;
+}
+
+unsigned long long kh_siphash_string(const char* const key, const KeyHashSeed_t* const seed)
+{
+	return kh_siphash_bytes(key, strlen(key), seed);
+}
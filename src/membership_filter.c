@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "key_hash.h"
+#include "membership_filter.h"
+
+#define MF_BLOCK_SIZE 64
+#define MF_COUNTERS_PER_BLOCK (MF_BLOCK_SIZE * 2)
+#define MF_PROBES 5
+
+// 10 counters per item and 5 probes keep false positives near 1%
+static const unsigned long MF_COUNTERS_PER_ITEM = 10;
+static const unsigned char MF_COUNTER_MAX = 15;
+
+typedef struct FilterBlock_s
+{
+	unsigned char nibbles[MF_BLOCK_SIZE];
+} FilterBlock_t;
+
+struct MembershipFilter_s
+{
+	unsigned long block_count;
+	FilterBlock_t* blocks;
+};
+
+MembershipFilter_t* mf_new(const unsigned long expected_items)
+{
+	MembershipFilter_t* const filter = (MembershipFilter_t*)malloc(sizeof(MembershipFilter_t));
+	const unsigned long counters = expected_items * MF_COUNTERS_PER_ITEM;
+
+	filter->block_count = counters / MF_COUNTERS_PER_BLOCK + 1;
+	filter->blocks = (FilterBlock_t*)aligned_alloc(MF_BLOCK_SIZE, filter->block_count * sizeof(FilterBlock_t));
+	memset(filter->blocks, 0, filter->block_count * sizeof(FilterBlock_t));
+
+	return filter;
+}
+
+void mf_delete(MembershipFilter_t* const filter)
+{
+	free(filter->blocks);
+	free(filter);
+}
+
+unsigned long mf_size_in_bytes(const MembershipFilter_t* const filter)
+{
+	return sizeof(MembershipFilter_t) + filter->block_count * sizeof(FilterBlock_t);
+}
+
+FilterBlock_t* block_of_hash(const MembershipFilter_t* const filter, const unsigned long long hash)
+{
+	return &filter->blocks[hash % filter->block_count];
+}
+
+unsigned counter_of_probe(const unsigned long long hash, const unsigned probe)
+{
+	// Block choice uses the low bits of hash, counters come from a remix of it
+	return (kh_mix(hash) >> (probe * 7)) % MF_COUNTERS_PER_BLOCK;
+}
+
+unsigned char read_counter(const FilterBlock_t* const block, const unsigned counter)
+{
+	return (block->nibbles[counter / 2] >> (counter % 2 * 4)) & 0xF;
+}
+
+void write_counter(FilterBlock_t* const block, const unsigned counter, const unsigned char value)
+{
+	unsigned char* const byte = &block->nibbles[counter / 2];
+	const unsigned shift = counter % 2 * 4;
+	*byte = (unsigned char)((*byte & ~(0xF << shift)) | (value << shift));
+}
+
+bool mf_may_contain(const MembershipFilter_t* const filter, const unsigned long long hash)
+{
+	const FilterBlock_t* const block = block_of_hash(filter, hash);
+
+	for (unsigned probe = 0; probe < MF_PROBES; ++probe)
+		if (read_counter(block, counter_of_probe(hash, probe)) == 0)
+			return false;
+
+	return true;
+}
+
+void mf_add(MembershipFilter_t* const filter, const unsigned long long hash)
+{
+	FilterBlock_t* const block = block_of_hash(filter, hash);
+
+	for (unsigned probe = 0; probe < MF_PROBES; ++probe)
+	{
+		const unsigned counter = counter_of_probe(hash, probe);
+		const unsigned char value = read_counter(block, counter);
+
+		if (value < MF_COUNTER_MAX)
+			write_counter(block, counter, value + 1);
+	}
+}
+
+void mf_remove(MembershipFilter_t* const filter, const unsigned long long hash)
+{
+	FilterBlock_t* const block = block_of_hash(filter, hash);
+
+	for (unsigned probe = 0; probe < MF_PROBES; ++probe)
+	{
+		const unsigned counter = counter_of_probe(hash, probe);
+		const unsigned char value = read_counter(block, counter);
+
+		// A saturated counter no longer knows how many keys it holds, so it must never reach zero
+		if (value > 0 && value < MF_COUNTER_MAX)
+			write_counter(block, counter, value - 1);
+	}
+}
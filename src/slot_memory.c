@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "slot_memory.h"
+
+unsigned long round_up_to_huge_page(const unsigned long bytes)
+{
+	return (bytes + SM_HUGE_PAGE_SIZE - 1) / SM_HUGE_PAGE_SIZE * SM_HUGE_PAGE_SIZE;
+}
+
+void* map_huge_page_aligned(const unsigned long size)
+{
+	// Huge pages need 2 MB alignment: over-map by one huge page, then trim both ends
+	const unsigned long padded = size + SM_HUGE_PAGE_SIZE;
+	unsigned char* const raw = (unsigned char*)mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (raw == MAP_FAILED)
+		return NULL;
+
+	const uintptr_t start = (uintptr_t)raw;
+	const uintptr_t aligned = (start + SM_HUGE_PAGE_SIZE - 1) / SM_HUGE_PAGE_SIZE * SM_HUGE_PAGE_SIZE;
+	const unsigned long head = aligned - start;
+	const unsigned long tail = padded - head - size;
+
+	if (head > 0)
+		munmap(raw, head);
+	if (tail > 0)
+		munmap((void*)(aligned + size), tail);
+
+#ifdef MADV_HUGEPAGE
+	madvise((void*)aligned, size, MADV_HUGEPAGE);
+#endif
+
+	return (void*)aligned;
+}
+
+SlotMemory_t sm_alloc_zeroed(const unsigned long bytes, const bool huge_pages)
+{
+	SlotMemory_t memory = { NULL, bytes, false };
+
+	if (huge_pages && bytes >= SM_HUGE_PAGE_SIZE)
+	{
+		memory.size = round_up_to_huge_page(bytes);
+		memory.base = map_huge_page_aligned(memory.size);
+		memory.mapped = memory.base != NULL;
+	}
+
+	if (!memory.mapped)
+	{
+		memory.size = bytes;
+		memory.base = calloc(bytes > 0 ? bytes : 1, 1);
+	}
+
+	return memory;
+}
+
+void sm_free(const SlotMemory_t memory)
+{
+	if (memory.mapped)
+		munmap(memory.base, memory.size);
+	else
+		free(memory.base);
+}
@@ -1,13 +1,45 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <stdbool.h>
 
 #include "article.h"
 #include "hashtable.h"
+#include "generic_hashtable.h"
+#include "key_hash.h"
+#include "file_table.h"
+#include "cuckoo_table.h"
+
+typedef struct CitationEdge_s
+{
+	unsigned long citing;
+	unsigned long cited;
+} CitationEdge_t;
+
+static inline unsigned long long hash_citation_edge(const CitationEdge_t edge)
+{
+	return ght_hash_unsigned_long(edge.citing * 0x9E3779B97F4A7C15lu ^ edge.cited);
+}
+
+static inline bool citation_edges_equal(const CitationEdge_t a, const CitationEdge_t b)
+{
+	return a.citing == b.citing && a.cited == b.cited;
+}
+
+GHT_GENERATE(IdTable, unsigned long, unsigned long, ght_hash_unsigned_long, GHT_EQUAL_SCALAR,
+		GHT_COPY_BY_VALUE, GHT_FREE_NOTHING, GHT_COPY_BY_VALUE, GHT_FREE_NOTHING)
+
+GHT_GENERATE(CitationTable, CitationEdge_t, unsigned, hash_citation_edge, citation_edges_equal,
+		GHT_COPY_BY_VALUE, GHT_FREE_NOTHING, GHT_COPY_BY_VALUE, GHT_FREE_NOTHING)
+
+GHT_GENERATE(ArticleTable, const char*, Article_t*, ght_hash_string, GHT_EQUAL_STRING,
+		GHT_COPY_STRING, GHT_FREE_STRING, duplicate_article, delete_article)
 
 bool global_failure;
 
+extern unsigned long ht_forced_lookup_threads;
+
 void debug(const char* message)
 {
 #ifndef NDEBUG
@@ -15,6 +47,46 @@ void debug(const char* message)
 #endif
 }
 
+// Articles 0 to n - 1, keyed <prefix><number>; free them with delete_articles
+Article_t** make_numbered_articles(const char* const prefix, const unsigned long n)
+{
+	Article_t** const articles = (Article_t**)malloc(n * sizeof(Article_t*));
+	char doi[32];
+
+	for (unsigned long i = 0; i < n; ++i)
+	{
+		sprintf(doi, "%s%lu", prefix, i);
+		articles[i] = make_article(doi, "Title", "Author", 1900 + i % 100);
+	}
+
+	return articles;
+}
+
+void delete_articles(Article_t** const articles, const unsigned long n)
+{
+	for (unsigned long i = 0; i < n; ++i)
+		delete_article(articles[i]);
+	free(articles);
+}
+
+// Keys longer than the DOI field, distinct within it; articles store them without a terminator
+const char* long_numbered_key(char* const buffer, const unsigned long i)
+{
+	sprintf(buffer, "10.1000/long.%06lu.runs.past.the.doi.field", i);
+	return buffer;
+}
+
+Article_t** make_long_numbered_articles(const unsigned long n)
+{
+	Article_t** const articles = (Article_t**)malloc(n * sizeof(Article_t*));
+	char doi[64];
+
+	for (unsigned long i = 0; i < n; ++i)
+		articles[i] = make_article(long_numbered_key(doi, i), "Title", "Author", 1900 + i % 100);
+
+	return articles;
+}
+
 void test_empty_hash_table()
 {
 	/*
@@ -213,6 +285,773 @@ void test_hash_table_resize()
 	ht_delete(ht);
 }
 
+void test_hash_table_churn()
+{
+	/*
+	 * Inserting and removing many distinct keys leaves REMOVED cells behind
+	 * Inserts must still land somewhere, and every live key must stay reachable
+	 */
+
+	HashTable_t* ht = ht_new();
+	const unsigned long total = 200, window = 20;
+	Article_t** articles = make_numbered_articles("DOI_", total);
+
+	for (unsigned long i = 0; i < total; ++i)
+	{
+		ht_insert(ht, articles[i]);
+		if (i >= window)
+			ht_remove(ht, key_of(articles[i - window]));
+	}
+
+	assert(ht_count(ht) == window);
+	for (unsigned long i = total - window; i < total; ++i)
+		assert(ht_contains(ht, key_of(articles[i])) == true);
+	debug("Churn: sliding window of inserts and removes keeps live keys");
+
+	delete_articles(articles, total);
+	ht_delete(ht);
+}
+
+void test_hash_table_stats()
+{
+	HashTable_t* ht = ht_new();
+	Article_t* a = make_article("DOI", "", "", 0);
+	HtStats_t stats;
+
+	ht_insert(ht, a);
+	ht_fetch(ht, "DOI");
+	ht_fetch(ht, "Missing_DOI");
+	ht_remove(ht, "DOI");
+	ht_expand(ht);
+	ht_read_stats(ht, &stats);
+
+#ifdef HT_INSTRUMENTATION
+	assert(stats.operations[HT_OP_INSERT].calls == 1);
+	assert(stats.operations[HT_OP_INSERT].allocations == 1);
+	assert(stats.operations[HT_OP_FETCH].calls == 2);
+	assert(stats.operations[HT_OP_FETCH].probes >= 2);
+	assert(stats.operations[HT_OP_REMOVE].calls == 1);
+	assert(stats.operations[HT_OP_RESIZE].calls == 1);
+	assert(stats.operations[HT_OP_RESIZE].allocations == 2);
+	debug("Stats: operations, probes and allocations are counted");
+#else
+	assert(stats.operations[HT_OP_INSERT].calls == 0);
+	debug("Stats: disabled instrumentation reports nothing");
+#endif
+
+	delete_article(a);
+	ht_delete(ht);
+}
+
+void test_hash_table_membership_filter()
+{
+	/*
+	 * A table with a membership filter must answer exactly like one without
+	 * Removed keys must stop matching, even after resizes rebuild the filter
+	 */
+
+	const HashTableOptions_t options = { .membership_filter = true };
+	HashTable_t* ht = ht_new_with_options(&options);
+	Article_t** articles = make_numbered_articles("10.1000/filter.", 100);
+
+	for (unsigned long i = 0; i < 100; ++i)
+		ht_insert(ht, articles[i]);
+
+	for (unsigned long i = 0; i < 100; i += 2)
+		ht_remove(ht, key_of(articles[i]));
+
+	assert(ht_count(ht) == 50);
+	for (unsigned long i = 0; i < 100; ++i)
+		assert(ht_contains(ht, key_of(articles[i])) == (i % 2 == 1));
+	assert(ht_fetch(ht, "10.1000/never.inserted") == NULL);
+	debug("Filter: removed and missing keys are rejected, present keys are kept");
+
+	ht_expand(ht);
+	for (unsigned long i = 1; i < 100; i += 2)
+		assert(articles_are_equal(ht_fetch(ht, key_of(articles[i])), articles[i]));
+	debug("Filter: survives resize");
+
+	delete_articles(articles, 100);
+	ht_delete(ht);
+}
+
+Article_t* load_article_for_test(const char* const key, void* const context)
+{
+	unsigned long* const loads = (unsigned long*)context;
+	(*loads)++;
+	return make_article(key, "Loaded", "", 0);
+}
+
+void test_hash_table_cache_mode()
+{
+	/*
+	 * A capped table evicts instead of growing past its limit
+	 * Recently fetched articles survive eviction, and misses go through the loader
+	 */
+
+	unsigned long loads = 0;
+	HashTableOptions_t options = { false };
+	options.max_items = 3;
+	options.loader = load_article_for_test;
+	options.loader_context = &loads;
+
+	HashTable_t* ht = ht_new_with_options(&options);
+	Article_t* a = make_article("DOI_a", "", "", 0);
+	Article_t* b = make_article("DOI_b", "", "", 0);
+	Article_t* c = make_article("DOI_c", "", "", 0);
+	Article_t* d = make_article("DOI_d", "", "", 0);
+
+	ht_insert(ht, a);
+	ht_insert(ht, b);
+	ht_insert(ht, c);
+	assert(ht_fetch(ht, "DOI_a") != NULL);
+	ht_insert(ht, d);
+
+	assert(ht_count(ht) == 3);
+	assert(ht_cache_evictions(ht) == 1);
+	assert(ht_contains(ht, "DOI_a") == true);
+	assert(ht_contains(ht, "DOI_d") == true);
+	debug("Cache: full table evicts an unreferenced article");
+
+	ht_insert(ht, d);
+	assert(ht_cache_evictions(ht) == 1);
+	debug("Cache: replacing a cached key does not evict");
+
+	const Article_t* loaded = ht_cache_fetch(ht, "DOI_loaded");
+	assert(loaded != NULL && loads == 1);
+	assert(ht_cache_fetch(ht, "DOI_loaded") == ht_fetch(ht, "DOI_loaded"));
+	assert(loads == 1);
+	assert(ht_count(ht) == 3);
+	assert(ht_cache_hits(ht) == 3 && ht_cache_misses(ht) == 1);
+	debug("Cache: read-through loads misses once, then hits");
+
+	delete_article(a);
+	delete_article(b);
+	delete_article(c);
+	delete_article(d);
+	ht_delete(ht);
+
+	// 6143 is right at the high density bound of capacity 8191, where every eviction used to rehash
+	const unsigned long limit = 6143, inserts = limit + 20000;
+	HashTableOptions_t boundary = { .max_items = limit };
+	HtStats_t stats;
+	char doi[32];
+	ht = ht_new_with_options(&boundary);
+	const unsigned long initial_capacity = ht_capacity(ht);
+
+	assert(initial_capacity >= 2 * limit);
+	for (unsigned long i = 0; i < inserts; ++i)
+	{
+		sprintf(doi, "10.6143/cache.%lu", i);
+		Article_t* article = make_article(doi, "", "", 0);
+		ht_insert(ht, article);
+		delete_article(article);
+	}
+
+	ht_read_stats(ht, &stats);
+	assert(ht_count(ht) == limit);
+	assert(ht_cache_evictions(ht) == inserts - limit);
+	assert(ht_capacity(ht) == initial_capacity);
+	assert(stats.operations[HT_OP_RESIZE].calls <= (inserts - limit) / (initial_capacity / 4) + 1);
+	assert(ht_contains(ht, doi) == true);
+	debug("Cache: limit at the density bound rehashes once per quarter table of evictions");
+	ht_delete(ht);
+}
+
+void test_generic_tables()
+{
+	/*
+	 * Generated tables behave like HashTable_t for their own key and value types
+	 */
+
+	IdTable_t* ids = IdTable_new();
+
+	for (unsigned long i = 0; i < 1000; ++i)
+		IdTable_insert(ids, i * 7, i);
+	for (unsigned long i = 0; i < 1000; i += 2)
+		IdTable_remove(ids, i * 7);
+
+	assert(IdTable_count(ids) == 500);
+	assert(*IdTable_fetch(ids, 7) == 1);
+	assert(IdTable_fetch(ids, 14) == NULL);
+	IdTable_insert(ids, 7, 42);
+	assert(*IdTable_fetch(ids, 7) == 42 && IdTable_count(ids) == 500);
+	debug("Generic table: integer ids insert, replace and remove");
+
+	for (unsigned long i = 0; i < 1000; ++i)
+		IdTable_remove(ids, i * 7);
+	assert(IdTable_count(ids) == 0);
+	assert(IdTable_capacity(ids) == calculate_optimal_capacity_for_index(0));
+	debug("Generic table: shrinks back when emptied");
+
+	for (unsigned long i = 0; i < 5; ++i)
+		IdTable_insert(ids, i, i);
+	IdTable_resize(ids, 5);
+	assert(IdTable_capacity(ids) == 5);
+	for (unsigned long i = 0; i < 5; ++i)
+		assert(*IdTable_fetch(ids, i) == i);
+	IdTable_resize(ids, 4);
+	assert(IdTable_capacity(ids) == 5);
+	debug("Generic table: resizes down to its count, like ht_resize, but not below");
+	IdTable_delete(ids);
+
+	CitationTable_t* citations = CitationTable_new();
+	const CitationEdge_t edge = { 1, 2 }, reverse_edge = { 2, 1 };
+	CitationTable_insert(citations, edge, 3);
+	assert(CitationTable_contains(citations, edge) == true);
+	assert(CitationTable_contains(citations, reverse_edge) == false);
+	debug("Generic table: struct keys");
+	CitationTable_delete(citations);
+
+	ArticleTable_t* articles = ArticleTable_new();
+	Article_t* a = make_article("DOI", "Title", "Author", 2000);
+	char key[] = "DOI";
+	ArticleTable_insert(articles, key, a);
+	key[0] = 'X';
+	assert(ArticleTable_contains(articles, "DOI") == true);
+	assert(articles_are_equal(*ArticleTable_fetch(articles, "DOI"), a));
+	debug("Generic table: owned string keys and article values");
+
+	assert(ght_hash_string("10.1000/xyz") == kh_hash_string("10.1000/xyz", 0));
+	assert(ght_hash_string("") == kh_hash_string("", 0));
+	debug("Generic table: inline string hash matches kh_hash_string");
+	delete_article(a);
+	ArticleTable_delete(articles);
+}
+
+void test_file_table()
+{
+	/*
+	 * A file-backed table grows past many bucket splits and overflow pages,
+	 * and reopening it restores every article without parsing anything
+	 */
+
+	remove("articles.ft");
+	remove("articles.ft.ovf");
+
+	FileTable_t* ft = ft_open("articles.ft");
+	Article_t** articles = make_numbered_articles("10.1000/file.", 2000);
+
+	assert(ft != NULL);
+	assert(ft_count(ft) == 0);
+	assert(ft_fetch(ft, "Some_DOI") == NULL);
+	debug("File table: new table is empty");
+
+	for (unsigned long i = 0; i < 2000; ++i)
+		assert(ft_insert(ft, articles[i]) == true);
+	for (unsigned long i = 0; i < 2000; i += 3)
+		ft_remove(ft, key_of(articles[i]));
+
+	const unsigned long buckets = ft_bucket_count(ft);
+	assert(buckets > 4);
+	assert(ft_count(ft) == 1333);
+	ft_insert(ft, articles[1]);
+	assert(ft_count(ft) == 1333);
+	debug("File table: buckets split as items arrive");
+
+	ft_close(ft);
+	ft = ft_open("articles.ft");
+
+	assert(ft != NULL);
+	assert(ft_count(ft) == 1333 && ft_bucket_count(ft) == buckets);
+	for (unsigned long i = 0; i < 2000; ++i)
+	{
+		const Article_t* fetched = ft_fetch(ft, key_of(articles[i]));
+		assert((fetched != NULL) == (i % 3 != 0));
+		assert(fetched == NULL || articles_are_equal(fetched, articles[i]));
+	}
+	debug("File table: contents persist across reopen");
+
+	delete_articles(articles, 2000);
+	ft_close(ft);
+
+	// Overflow chains would point past the end of a missing or cut-short overflow file
+	remove("articles.ft.ovf");
+	assert(ft_open("articles.ft") == NULL);
+	FILE* damaged = fopen("articles.ft", "w");
+	fputs("not a table", damaged);
+	fclose(damaged);
+	assert(ft_open("articles.ft") == NULL);
+	debug("File table: damaged files are refused");
+
+	// Two copies of an article that differ only in the bytes past their terminators make identical records
+	Article_t* original = make_article("DOI", "T", "", 7);
+	Article_t* copies = make_article_block(2);
+	unsigned char records[2][256];
+	memset(article_in_block(copies, 0), 0xAA, article_footprint());
+	memset(article_in_block(copies, 1), 0x55, article_footprint());
+	for (unsigned long c = 0; c < 2; ++c)
+	{
+		copy_article(original, article_in_block(copies, c));
+		article_to_record(article_in_block(copies, c), records[c]);
+	}
+	assert(memcmp(records[0], records[1], article_footprint()) == 0);
+	assert(articles_are_equal(article_view_of_record(records[0]), original));
+	delete_article_block(copies);
+	delete_article(original);
+	debug("File table: records carry no stray bytes past the fields");
+
+	// Splits rehash stored keys, which must land where the callers' full keys do
+	remove("articles.ft");
+	remove("articles.ft.ovf");
+	ft = ft_open("articles.ft");
+	articles = make_long_numbered_articles(3000);
+	char doi[64];
+	for (unsigned long i = 0; i < 3000; ++i)
+		assert(ft_insert(ft, articles[i]) == true);
+	assert(ft_count(ft) == 3000);
+	assert(ft_bucket_count(ft) > 8);
+	ft_close(ft);
+
+	ft = ft_open("articles.ft");
+	assert(ft != NULL && ft_count(ft) == 3000);
+	for (unsigned long i = 0; i < 3000; ++i)
+		assert(articles_are_equal(ft_fetch(ft, long_numbered_key(doi, i)), articles[i]));
+	for (unsigned long i = 0; i < 3000; i += 2)
+		ft_remove(ft, long_numbered_key(doi, i));
+	assert(ft_count(ft) == 1500);
+	for (unsigned long i = 0; i < 3000; ++i)
+		assert(ft_contains(ft, long_numbered_key(doi, i)) == (i % 2 == 1));
+	debug("File table: keys longer than the DOI field, through splits and reopen");
+
+	delete_articles(articles, 3000);
+	ft_close(ft);
+}
+
+void test_frozen_table()
+{
+	/*
+	 * Freezing keeps every article reachable and rejects everything else,
+	 * and a saved frozen table maps back with the same contents
+	 */
+
+	HashTable_t* ht = ht_new();
+	Article_t** articles = make_numbered_articles("10.1000/frozen.", 500);
+
+	for (unsigned long i = 0; i < 500; ++i)
+		ht_insert(ht, articles[i]);
+
+	FrozenTable_t* fz = ht_freeze(ht);
+	assert(fz_count(fz) == 500);
+	for (unsigned long i = 0; i < 500; ++i)
+		assert(articles_are_equal(fz_fetch(fz, key_of(articles[i])), articles[i]));
+	assert(fz_contains(fz, "10.1000/frozen.500") == false);
+	debug("Frozen table: every key found, missing key rejected");
+
+	FILE* fp = fopen("frozen.bin", "wb");
+	fz_save(fz, fp);
+	fclose(fp);
+	fz_delete(fz);
+
+	fz = fz_map("frozen.bin");
+	assert(fz != NULL && fz_count(fz) == 500);
+	for (unsigned long i = 0; i < 500; ++i)
+		assert(articles_are_equal(fz_fetch(fz, key_of(articles[i])), articles[i]));
+	debug("Frozen table: saved image maps back");
+	fz_delete(fz);
+
+	ht_delete(ht);
+	ht = ht_new();
+	fz = ht_freeze(ht);
+	assert(fz_count(fz) == 0 && fz_fetch(fz, "Some_DOI") == NULL);
+	debug("Frozen table: empty table freezes");
+	fz_delete(fz);
+
+	delete_articles(articles, 500);
+	ht_delete(ht);
+
+	// Freezing hashes stored keys, which must land where the callers' full keys do
+	ht = ht_new();
+	articles = make_long_numbered_articles(3000);
+	char doi[64];
+	for (unsigned long i = 0; i < 3000; ++i)
+		ht_insert(ht, articles[i]);
+	fz = ht_freeze(ht);
+	for (unsigned long i = 0; i < 3000; ++i)
+		assert(articles_are_equal(fz_fetch(fz, long_numbered_key(doi, i)), articles[i]));
+
+	fp = fopen("frozen.bin", "wb");
+	fz_save(fz, fp);
+	fclose(fp);
+	fz_delete(fz);
+
+	fz = fz_map("frozen.bin");
+	assert(fz != NULL && fz_count(fz) == 3000);
+	for (unsigned long i = 0; i < 3000; ++i)
+		assert(articles_are_equal(fz_fetch(fz, long_numbered_key(doi, i)), articles[i]));
+	assert(fz_contains(fz, long_numbered_key(doi, 3000)) == false);
+	debug("Frozen table: keys longer than the DOI field, frozen and mapped back");
+	fz_delete(fz);
+
+	delete_articles(articles, 3000);
+	ht_delete(ht);
+}
+
+void test_cuckoo_table()
+{
+	/*
+	 * Sequential, clustered DOIs must all stay reachable through
+	 * displacements and growth, and removal must free their slots
+	 */
+
+	CuckooTable_t* ct = ct_new();
+	Article_t** articles = make_numbered_articles("10.1000/abc.", 3000);
+
+	assert(ct_count(ct) == 0 && ct_fetch(ct, "Some_DOI") == NULL);
+	debug("Cuckoo table: new table is empty");
+
+	for (unsigned long i = 0; i < 3000; ++i)
+		ct_insert(ct, articles[i]);
+
+	assert(ct_count(ct) == 3000 && ct_capacity(ct) >= 3000);
+	for (unsigned long i = 0; i < 3000; ++i)
+		assert(articles_are_equal(ct_fetch(ct, key_of(articles[i])), articles[i]));
+	debug("Cuckoo table: every inserted key is found");
+
+	ct_insert(ct, articles[0]);
+	assert(ct_count(ct) == 3000);
+	for (unsigned long i = 0; i < 3000; i += 2)
+		ct_remove(ct, key_of(articles[i]));
+	assert(ct_count(ct) == 1500);
+	for (unsigned long i = 0; i < 3000; ++i)
+		assert(ct_contains(ct, key_of(articles[i])) == (i % 2 == 1));
+	debug("Cuckoo table: replace and remove");
+
+	delete_articles(articles, 3000);
+	ct_delete(ct);
+
+	// Growth and displacements rehash stored keys, which must land where the callers' full keys do
+	ct = ct_new();
+	articles = make_long_numbered_articles(3000);
+	char doi[64];
+	for (unsigned long i = 0; i < 3000; ++i)
+		ct_insert(ct, articles[i]);
+	assert(ct_count(ct) == 3000);
+	for (unsigned long i = 0; i < 3000; ++i)
+		assert(articles_are_equal(ct_fetch(ct, long_numbered_key(doi, i)), articles[i]));
+	for (unsigned long i = 0; i < 3000; i += 2)
+		ct_remove(ct, long_numbered_key(doi, i));
+	assert(ct_count(ct) == 1500);
+	for (unsigned long i = 0; i < 3000; ++i)
+		assert(ct_contains(ct, long_numbered_key(doi, i)) == (i % 2 == 1));
+	debug("Cuckoo table: keys longer than the DOI field");
+
+	delete_articles(articles, 3000);
+	ct_delete(ct);
+}
+
+unsigned long public_constant_hash(const char* key, const unsigned long capacity)
+{
+	// The fixed-constant hash, as anyone reading the source can recompute it
+	unsigned long h = 0, multiplier = 31415;
+
+	for (; *key != '\0'; ++key)
+	{
+		h = (multiplier * h + *key) % capacity;
+		multiplier = (multiplier * 27183) % (capacity - 1);
+	}
+
+	return h;
+}
+
+void test_hash_table_seeded_hash()
+{
+	/*
+	 * Seeded tables behave like any other table
+	 * A flood of keys crafted to collide under the fixed constants makes the table switch to the keyed hash
+	 */
+
+	const HashTableOptions_t seeded = { .seeded_hash = true };
+	HashTable_t* ht = ht_new_with_options(&seeded);
+	Article_t* a = make_article("DOI", "", "", 0);
+
+	assert(ht_is_seeded(ht) == true);
+	ht_insert(ht, a);
+	assert(articles_are_equal(ht_fetch(ht, "DOI"), a));
+	ht_remove(ht, "DOI");
+	assert(ht_is_empty(ht) == true);
+	debug("Seeded hash: basic operations");
+	ht_delete(ht);
+	delete_article(a);
+
+	const unsigned long capacity = 1021, flood = 300;
+	Article_t* crafted[300];
+	char doi[32];
+	ht = ht_new();
+	ht_resize(ht, capacity);
+
+	for (unsigned long found = 0, i = 0; found < flood; ++i)
+	{
+		sprintf(doi, "10.666/flood.%lu", i);
+		if (public_constant_hash(doi, capacity) == 0)
+			crafted[found++] = make_article(doi, "", "", 0);
+	}
+
+	assert(ht_is_seeded(ht) == false);
+	for (unsigned long i = 0; i < flood; ++i)
+		ht_insert(ht, crafted[i]);
+
+	assert(ht_is_seeded(ht) == true);
+	assert(ht_count(ht) == flood);
+	for (unsigned long i = 0; i < flood; ++i)
+		assert(ht_contains(ht, key_of(crafted[i])) == true);
+	debug("Seeded hash: colliding flood switches table to keyed hash");
+
+	for (unsigned long i = 0; i < flood; ++i)
+		delete_article(crafted[i]);
+	ht_delete(ht);
+}
+
+void test_hash_table_huge_pages()
+{
+	/*
+	 * Huge-page tables behave like any other table, through growth past the mapping threshold and back
+	 */
+
+	const HashTableOptions_t huge = { .huge_pages = true };
+	HashTable_t* ht = ht_new_with_options(&huge);
+	Article_t** articles = make_numbered_articles("10.2048/huge.", 64);
+
+	for (int i = 0; i < 64; ++i)
+		ht_insert(ht, articles[i]);
+
+	ht_resize(ht, 300000);
+	assert(ht_capacity(ht) >= 300000);
+	assert(ht_count(ht) == 64);
+	for (int i = 0; i < 64; ++i)
+		assert(articles_are_equal(ht_fetch(ht, key_of(articles[i])), articles[i]));
+	debug("Huge pages: mapped slot arrays hold every article");
+
+	for (int i = 0; i < 32; ++i)
+		ht_remove(ht, key_of(articles[i]));
+	ht_resize(ht, 127);
+	assert(ht_capacity(ht) == 127);
+	assert(ht_count(ht) == 32);
+	for (int i = 32; i < 64; ++i)
+		assert(ht_contains(ht, key_of(articles[i])) == true);
+	debug("Huge pages: resizing back down to heap slot arrays");
+
+	delete_articles(articles, 64);
+	ht_delete(ht);
+}
+
+void test_hash_table_compact()
+{
+	/*
+	 * Compacting goes straight to the smallest capacity that fits, packs articles into one block,
+	 * and the table keeps working normally on top of that block
+	 */
+
+	HashTable_t* ht = ht_new();
+	Article_t** articles = make_numbered_articles("10.4096/compact.", 400);
+
+	for (int i = 0; i < 400; ++i)
+		ht_insert(ht, articles[i]);
+
+	for (int i = 0; i < 390; ++i)
+		ht_remove(ht, key_of(articles[i]));
+
+	const HtMemoryUsage_t before = ht_memory_usage(ht);
+	assert(before.articles == 10 * article_footprint());
+	assert(before.total == before.slots + before.metadata + before.articles);
+
+	ht_compact(ht);
+	const HtMemoryUsage_t after = ht_memory_usage(ht);
+	assert(ht_count(ht) == 10);
+	assert(ht_capacity(ht) >= 10 / 0.75);
+	assert(after.slots <= before.slots);
+	assert(after.articles == 10 * article_footprint());
+	for (int i = 390; i < 400; ++i)
+		assert(articles_are_equal(ht_fetch(ht, key_of(articles[i])), articles[i]));
+	debug("Compact: smallest fitting capacity, every article kept");
+
+	ht_insert(ht, articles[0]);
+	ht_insert(ht, articles[395]);
+	ht_remove(ht, key_of(articles[390]));
+	ht_expand(ht);
+	assert(ht_count(ht) == 10);
+	assert(ht_memory_usage(ht).articles == 12 * article_footprint()); // Two heap articles, ten arena slots
+	assert(ht_contains(ht, key_of(articles[0])) == true);
+	assert(ht_contains(ht, key_of(articles[390])) == false);
+	assert(articles_are_equal(ht_fetch(ht, key_of(articles[399])), articles[399]));
+	debug("Compact: inserts, replaces, removes and resizes mix with packed articles");
+
+	ht_compact(ht);
+	assert(ht_memory_usage(ht).articles == 10 * article_footprint());
+	for (int i = 0; i < 400; ++i)
+		if (i == 0 || i > 390)
+			ht_remove(ht, key_of(articles[i]));
+	assert(ht_is_empty(ht) == true);
+	assert(ht_memory_usage(ht).articles == 0);
+	debug("Compact: packed block released with its last article");
+
+	delete_articles(articles, 400);
+	ht_delete(ht);
+}
+
+void test_hash_table_merge_and_diff()
+{
+	/*
+	 * Merging moves every source article into the destination under the chosen policy and empties the source
+	 * Diffing reports keys only in the new table, keys only in the old one, and keys whose article changed
+	 * Lookups run on several threads however many cores this machine has
+	 */
+
+	ht_forced_lookup_threads = 4;
+	const unsigned long items = 40000;
+	HashTable_t* older = ht_new();
+	HashTable_t* newer = ht_new();
+	char doi[32];
+
+	// Older holds keys [0, 3/4), newer holds [1/4, 1); the middle half changes year in every other key
+	for (unsigned long i = 0; i < items; ++i)
+	{
+		sprintf(doi, "10.8192/merge.%lu", i);
+		Article_t* a = make_article(doi, "", "", 1);
+		Article_t* b = make_article(doi, "", "", i % 2 == 0 ? 2 : 1);
+
+		if (i < items / 4 * 3)
+			ht_insert(older, a);
+		if (i >= items / 4)
+			ht_insert(newer, b);
+
+		delete_article(a);
+		delete_article(b);
+	}
+
+	HtDiff_t diff = ht_diff(older, newer);
+	assert(diff.added_count == items / 4);
+	assert(diff.removed_count == items / 4);
+	assert(diff.changed_count == items / 4);
+	for (unsigned long i = 0; i < diff.added_count; ++i)
+		assert(ht_contains(older, key_of(diff.added[i])) == false);
+	for (unsigned long i = 0; i < diff.removed_count; ++i)
+		assert(ht_contains(newer, key_of(diff.removed[i])) == false);
+	for (unsigned long i = 0; i < diff.changed_count; ++i)
+		assert(ht_fetch(newer, key_of(diff.changed[i])) == diff.changed[i]);
+	ht_free_diff(&diff);
+	debug("Diff: added, removed and changed keys");
+
+	diff = ht_diff(older, older);
+	assert(diff.added_count == 0 && diff.removed_count == 0 && diff.changed_count == 0);
+	ht_free_diff(&diff);
+	debug("Diff: a table against itself is empty");
+
+	// Packed source articles cannot move out of their block, so they are copied instead
+	ht_compact(newer);
+	ht_merge(older, newer, HT_MERGE_TAKE_SOURCE);
+	assert(ht_is_empty(newer) == true);
+	assert(ht_count(older) == items);
+	sprintf(doi, "10.8192/merge.%lu", items / 2);
+	assert(ht_fetch(older, doi) != NULL);
+	debug("Merge: source articles win and the source is left empty");
+
+	HashTable_t* small = ht_new();
+	Article_t* kept = make_article(doi, "kept", "", 0);
+	Article_t* extra = make_article("10.8192/extra", "", "", 0);
+	ht_insert(small, kept);
+	ht_insert(small, extra);
+	ht_merge(older, small, HT_MERGE_KEEP_DESTINATION);
+	assert(ht_count(older) == items + 1);
+	assert(articles_are_equal(ht_fetch(older, doi), kept) == false);
+	assert(articles_are_equal(ht_fetch(older, "10.8192/extra"), extra));
+	debug("Merge: destination articles win on shared keys");
+
+	ht_insert(newer, kept);
+	ht_merge(older, newer, HT_MERGE_TAKE_SOURCE);
+	assert(articles_are_equal(ht_fetch(older, doi), kept));
+	ht_merge(older, older, HT_MERGE_TAKE_SOURCE);
+	assert(ht_count(older) == items + 1);
+	debug("Merge: reusing an emptied source, and merging a table into itself");
+
+	delete_article(kept);
+	delete_article(extra);
+	ht_delete(small);
+	ht_delete(older);
+	ht_delete(newer);
+	ht_forced_lookup_threads = 0;
+}
+
+void test_hash_table_length_delimited_keys()
+{
+	/*
+	 * Keys can be spans of a bigger buffer, with no terminator of their own
+	 * Every kind of table finds them as it finds terminated keys, and stale precomputed hashes still work
+	 */
+
+	const char buffer[] = "10.1000/alpha10.1000/beta10.1000/gamma";
+	const HashTableOptions_t variants[] = {
+			{ .membership_filter = false }, { .membership_filter = true }, { .seeded_hash = true }
+	};
+	Article_t* alpha = make_article("10.1000/alpha", "", "", 0);
+	Article_t* beta = make_article("10.1000/beta", "", "", 0);
+
+	for (int v = 0; v < 3; ++v)
+	{
+		HashTable_t* ht = ht_new_with_options(&variants[v]);
+		ht_insert(ht, alpha);
+		ht_insert(ht, beta);
+
+		assert(articles_are_equal(ht_fetch_n(ht, buffer, 13), alpha));
+		assert(articles_are_equal(ht_fetch_n(ht, buffer + 13, 12), beta));
+		assert(ht_contains_n(ht, buffer + 25, 13) == false);
+		assert(ht_contains_n(ht, buffer, 12) == false);
+		assert(ht_contains_n(ht, buffer + 13, 13) == false);
+
+		const HtKeyHash_t hash = ht_key_hash(ht, buffer + 13, 12);
+		assert(articles_are_equal(ht_fetch_hashed(ht, buffer + 13, 12, hash), beta));
+		ht_resize(ht, 1021);
+		assert(articles_are_equal(ht_fetch_hashed(ht, buffer + 13, 12, hash), beta));
+
+		ht_remove_n(ht, buffer, 13);
+		assert(ht_contains(ht, "10.1000/alpha") == false);
+		assert(ht_count(ht) == 1);
+		ht_delete(ht);
+	}
+	debug("Length-delimited keys: fetch, contains, remove and precomputed hashes on plain, filtered and seeded tables");
+
+	const char long_key[] = "10.1000/a.key.longer.than.the.doi.field";
+	Article_t* truncated = make_article(long_key, "", "", 0);
+	Article_t* longer = make_article("10.1000/a.key.longer.than.the.doi.other", "title", "", 0);
+	for (int v = 0; v < 3; ++v)
+	{
+		HashTable_t* ht = ht_new_with_options(&variants[v]);
+		ht_insert(ht, truncated);
+		assert(ht_contains_n(ht, long_key, strlen(long_key)));
+		assert(ht_contains_n(ht, long_key, 32));
+		assert(ht_contains(ht, long_key));
+		assert(ht_contains_n(ht, long_key, 31) == false);
+
+		// Keys that agree on the stored bytes are the same key
+		ht_insert(ht, longer);
+		assert(ht_count(ht) == 1);
+		assert(articles_are_equal(ht_fetch(ht, long_key), longer));
+		ht_remove_n(ht, long_key, strlen(long_key));
+		assert(ht_is_empty(ht));
+		ht_delete(ht);
+	}
+	debug("Length-delimited keys: keys past the field length find their truncated copies");
+
+	const char spans[] = "10.1000/alphaXYZ";
+	assert(article_has_key_n(alpha, spans, 13));
+	assert(article_has_key_n(alpha, spans, 14) == false);
+	assert(article_has_key_n(alpha, spans, strlen(spans)) == false);
+	assert(article_has_key_n(truncated, long_key, strlen(long_key)));
+
+	HashTable_t* ht = ht_new();
+	ht_insert(ht, alpha);
+	assert(ht_contains_n(ht, spans, 13));
+	assert(ht_contains_n(ht, spans, 14) == false);
+	assert(ht_contains_n(ht, spans, 12) == false);
+	debug("Length-delimited keys: spans that run on into more key bytes do not match");
+
+	ht_delete(ht);
+	delete_article(longer);
+	delete_article(truncated);
+	delete_article(alpha);
+	delete_article(beta);
+}
+
 void test_hash_table_file_operations_empty_table()
 {
 	HashTable_t* ht = ht_new();
@@ -352,6 +1191,19 @@ int main(void)
 	test_hash_table_multiple_articles();
 	test_hash_table_insert_override_key();
 	test_hash_table_resize();
+	test_hash_table_churn();
+	test_hash_table_stats();
+	test_hash_table_membership_filter();
+	test_hash_table_cache_mode();
+	test_hash_table_seeded_hash();
+	test_hash_table_huge_pages();
+	test_hash_table_compact();
+	test_hash_table_merge_and_diff();
+	test_hash_table_length_delimited_keys();
+	test_generic_tables();
+	test_file_table();
+	test_frozen_table();
+	test_cuckoo_table();
 	test_hash_table_file_operations();
 
 	global_failure = false;